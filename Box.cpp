@@ -1,10 +0,0 @@
-#include "Box.h"
-#include "MemoryOperators.h"
-#include "TrackerIndex.h"
-
-#ifdef _DEBUG
-void* Box::operator new(size_t size)
-{
-	return ::operator new(size, MemoryManager::TrackerIndex::Box);
-}
-#endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "Broadphase.h"
+#include "ColliderStore.h"
+#include <limits>
+
+void Broadphase::Update(std::vector<CollisionPair>& pairs)
+{
+	BeginBuild();
+	pool.ParallelFor(BinCount(), 1, [this](const unsigned int bin, const unsigned int) { CountBin(bin); });
+	PrefixSum();
+	pool.ParallelFor(BinCount(), 1, [this](const unsigned int bin, const unsigned int) { ScatterBin(bin); });
+
+	threadPairs.resize(pool.ThreadCount());
+	for (std::vector<CollisionPair>& buffer : threadPairs)
+	{
+		buffer.clear();
+	}
+
+	pool.ParallelFor(GatherRegions(), 1, [this](const unsigned int index, const unsigned int threadIndex) {
+		FindRegionPairs(index, threadPairs[threadIndex]);
+	});
+
+	// merge the per thread buffers in thread order
+	pairs.clear();
+	for (const std::vector<CollisionPair>& buffer : threadPairs)
+	{
+		pairs.insert(pairs.end(), buffer.begin(), buffer.end());
+	}
+
+	Adapt();
+}
+
+void Broadphase::SizeBins()
+{
+	// bins start on batch boundaries so each can be integrated on its own
+	bodyCount = colliders.Count();
+	binCount = pool.ThreadCount();
+	binSize = (bodyCount + binCount - 1) / binCount;
+	binSize = (binSize + ColliderStore::batchWidth - 1) & ~static_cast<unsigned int>(ColliderStore::batchWidth - 1);
+}
+
+void Broadphase::QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const
+{
+	// broadphases with nothing better to search test every body
+	for (unsigned int id = 0; id < colliders.Count(); ++id)
+	{
+		if (PhysicsKernels::Bounds::FromStore(colliders, id).Overlaps(bounds))
+		{
+			ids.push_back(id);
+		}
+	}
+}
+
+void Broadphase::QueryRay(const Vec3& origin, const Vec3& direction, std::vector<unsigned int>& ids) const
+{
+	const Vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	for (unsigned int id = 0; id < colliders.Count(); ++id)
+	{
+		if (RayHits(PhysicsKernels::Bounds::FromStore(colliders, id), origin, inverseDirection))
+		{
+			ids.push_back(id);
+		}
+	}
+}
+
+bool Broadphase::RayHits(const PhysicsKernels::Bounds& bounds, const Vec3& origin, const Vec3& inverseDirection)
+{
+	// slab test, the ray is inside the bounds between where it has entered all three slabs and left none.
+	// A zero direction component gives infinite distances, which still compare correctly
+	float entryDistance = 0.0f;
+	float exitDistance = std::numeric_limits<float>::max();
+	const float mins[3] = { bounds.minX, bounds.minY, bounds.minZ };
+	const float maxs[3] = { bounds.maxX, bounds.maxY, bounds.maxZ };
+	for (int i = 0; i < 3; i++)
+	{
+		float slabEntry = (mins[i] - origin[i]) * inverseDirection[i];
+		float slabExit = (maxs[i] - origin[i]) * inverseDirection[i];
+		if (slabEntry > slabExit) std::swap(slabEntry, slabExit);
+		entryDistance = std::max(entryDistance, slabEntry);
+		exitDistance = std::min(exitDistance, slabExit);
+	}
+	return entryDistance <= exitDistance;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "NarrowPhase.h"
+#include "PhysicsKernels.h"
+#include "ThreadPool.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <vector>
+
+class ColliderStore;
+
+/// <summary>
+/// First half of collision detection, finds the pairs of bodies that may be touching. Every broadphase works
+/// in the same stages so the frame graph can run any of them, and they can be swapped between steps:
+/// BeginBuild, then CountBin for each bin, PrefixSum, ScatterBin for each bin, GatherRegions, then
+/// FindRegionPairs for each region and finally Adapt. The per bin and per region stages can run in parallel.
+/// Update runs all of them in turn for anything outside of the frame graph
+/// </summary>
+class Broadphase
+{
+public:
+	Broadphase(ThreadPool& pool, ColliderStore& colliders) : pool(pool), colliders(colliders) {}
+	virtual ~Broadphase() = default;
+
+	Broadphase(const Broadphase&) = delete;
+	Broadphase& operator=(const Broadphase&) = delete;
+
+	/// <summary>
+	/// Bins every body in the store where it is now and fills pairs with every candidate pair
+	/// </summary>
+	void Update(std::vector<CollisionPair>& pairs);
+
+	/// <summary>
+	/// Starts a step, sizing the bins for the bodies in the store
+	/// </summary>
+	virtual void BeginBuild() = 0;
+
+	// bins cover ranges of ids that start on a batch boundary, so bodies can be integrated bin by bin too.
+	// Trailing bins are empty when there are few bodies, and start at the body count rather than a boundary
+	inline unsigned int BinCount() const { return binCount; }
+	inline unsigned int BinBegin(const unsigned int bin) const { return std::min(bin * binSize, bodyCount); }
+	inline unsigned int BinEnd(const unsigned int bin) const { return std::min((bin + 1) * binSize, bodyCount); }
+
+	virtual void CountBin(const unsigned int bin) = 0;
+	virtual void PrefixSum() = 0;
+	virtual void ScatterBin(const unsigned int) {}
+
+	/// <summary>
+	/// Splits the work of finding pairs into regions that can be searched independently
+	/// </summary>
+	/// <returns>number of regions</returns>
+	virtual unsigned int GatherRegions() = 0;
+	virtual unsigned int RegionCount() const = 0;
+
+	/// <summary>
+	/// Appends the candidate pairs of one region, no pair is emitted by more than one region
+	/// </summary>
+	virtual void FindRegionPairs(const unsigned int region, std::vector<CollisionPair>& pairs) const = 0;
+
+	/// <summary>
+	/// Reshapes the structure to fit this step's bodies, once nothing reads it again this step
+	/// </summary>
+	virtual void Adapt() {}
+
+	/// <summary>
+	/// Appends the bodies whose bounds overlap the given ones. Answers from the last step, so bodies
+	/// added or removed since may be missed or reported under an old id
+	/// </summary>
+	virtual void QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const;
+
+	/// <summary>
+	/// Appends the bodies whose bounds the ray from origin along direction passes through, in no particular order.
+	/// Answers from the last step like QueryBounds
+	/// </summary>
+	virtual void QueryRay(const Vec3& origin, const Vec3& direction, std::vector<unsigned int>& ids) const;
+
+	virtual const char* Name() const = 0;
+
+protected:
+	ThreadPool& pool;
+	ColliderStore& colliders;
+
+	unsigned int bodyCount = 0;
+	unsigned int binCount = 0;
+	unsigned int binSize = 0;
+
+	/// <summary>
+	/// Sizes one bin per thread of the pool for the bodies in the store
+	/// </summary>
+	void SizeBins();
+
+	/// <summary>
+	/// Whether the ray from origin, given as one over each component of its direction, passes through bounds
+	/// </summary>
+	static bool RayHits(const PhysicsKernels::Bounds& bounds, const Vec3& origin, const Vec3& inverseDirection);
+
+private:
+	std::vector<std::vector<CollisionPair>> threadPairs; // pairs emitted by each thread during Update
+};
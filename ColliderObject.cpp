@@ -1 +1,102 @@
-#include "ColliderObject.h"
\ No newline at end of file
+#include "ColliderObject.h"
+#include <GL/glut.h>
+#include "Random.h"
+#include <utility>
+
+namespace ColliderObject
+{
+    namespace
+    {
+        Random random;
+    }
+
+    void seedRandom(const unsigned int seed)
+    {
+        random.Seed(seed);
+    }
+
+    void draw(const ColliderStore& store, const unsigned int id)
+    {
+        draw(store, id, store.Position(id));
+    }
+
+    void draw(const ColliderStore& store, const unsigned int id, const Vec3& position)
+    {
+        glPushMatrix();
+        glTranslatef(position.x, position.y, position.z);
+        GLfloat diffuseMaterial[] = { store.colourX[id], store.colourY[id], store.colourZ[id], 1.0f };
+        glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuseMaterial);
+        glScalef(store.sizeX[id], store.sizeY[id], store.sizeZ[id]);
+        glRotatef(-90, 1, 0, 0);
+        switch (store.type[id])
+        {
+        case ColliderType::Box:
+            glutSolidCube(1.0);
+            break;
+        case ColliderType::Sphere:
+            glutSolidSphere(0.5, 5, 5);
+            break;
+        }
+        glPopMatrix();
+    }
+
+    bool rayBoxIntersection(const ColliderStore& store, const unsigned int id, const Vec3& rayOrigin, const Vec3& rayDirection)
+    {
+        const Vec3 position = store.Position(id);
+        const Vec3 size = store.Size(id);
+
+        float tMin = (position.x - size.x / 2.0f - rayOrigin.x) / rayDirection.x;
+        float tMax = (position.x + size.x / 2.0f - rayOrigin.x) / rayDirection.x;
+
+        if (tMin > tMax) std::swap(tMin, tMax);
+
+        float tyMin = (position.y - size.y / 2.0f - rayOrigin.y) / rayDirection.y;
+        float tyMax = (position.y + size.y / 2.0f - rayOrigin.y) / rayDirection.y;
+
+        if (tyMin > tyMax) std::swap(tyMin, tyMax);
+
+        if ((tMin > tyMax) || (tyMin > tMax))
+            return false;
+
+        if (tyMin > tMin)
+            tMin = tyMin;
+
+        if (tyMax < tMax)
+            tMax = tyMax;
+
+        float tzMin = (position.z - size.z / 2.0f - rayOrigin.z) / rayDirection.z;
+        float tzMax = (position.z + size.z / 2.0f - rayOrigin.z) / rayDirection.z;
+
+        if (tzMin > tzMax) std::swap(tzMin, tzMax);
+
+        if ((tMin > tzMax) || (tzMin > tMax))
+            return false;
+
+        return true;
+    }
+
+    unsigned int createCollider(ColliderStore& store, const ColliderType type)
+    {
+        const unsigned int id = store.Add(type);
+
+        // Assign random x, y, and z positions within specified ranges
+        store.positionX[id] = random.NextFloat() * 20.0f;
+        store.positionY[id] = 10.0f + random.NextFloat();
+        store.positionZ[id] = random.NextFloat() * 20.0f;
+
+        store.sizeX[id] = store.sizeY[id] = store.sizeZ[id] = 1.0f;
+
+        // Assign random x-velocity between -1.0f and 1.0f
+        float randomXVelocity = -1.0f + random.NextFloat() * 2.0f;
+        store.velocityX[id] = randomXVelocity;
+        store.velocityY[id] = 0.0f;
+        store.velocityZ[id] = 0.0f;
+
+        // Assign a random color to the box
+        store.colourX[id] = random.NextFloat();
+        store.colourY[id] = random.NextFloat();
+        store.colourZ[id] = random.NextFloat();
+
+        return id;
+    }
+}
@@ -1,34 +1,25 @@
 #pragma once
 
 #include "Vec3.h"
-#include <array>
-#include <GL/glut.h>
 #include "globals.h"
-#include <mutex>
-#include "LinkedVector.h"
+#include "ColliderStore.h"
+#include <cmath>
 
-class ColliderObject
+/// <summary>
+/// Physics functions for a single body in a ColliderStore, referred to by id
+/// </summary>
+namespace ColliderObject
 {
-public:
-    Vec3 position;
-    Vec3 size;
-    Vec3 velocity;
-    Vec3 colour;
-
-    ColliderObject* pNext = nullptr;
-    bool isBox = false;
-
     // if two colliders collide, push them away from each other
-    static void resolveCollision(ColliderObject* a, ColliderObject* b) {
-        Vec3 normal = { a->position.x - b->position.x, a->position.y - b->position.y, a->position.z - b->position.z };
-        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    inline void resolveCollision(ColliderStore& store, const unsigned int a, const unsigned int b) {
+        Vec3 normal = { store.positionX[a] - store.positionX[b], store.positionY[a] - store.positionY[b], store.positionZ[a] - store.positionZ[b] };
 
         // Normalize the normal vector
         normal.normalise();
 
-        float relativeVelocityX = a->velocity.x - b->velocity.x;
-        float relativeVelocityY = a->velocity.y - b->velocity.y;
-        float relativeVelocityZ = a->velocity.z - b->velocity.z;
+        float relativeVelocityX = store.velocityX[a] - store.velocityX[b];
+        float relativeVelocityY = store.velocityY[a] - store.velocityY[b];
+        float relativeVelocityZ = store.velocityZ[a] - store.velocityZ[b];
 
         // Compute the relative velocity along the normal
         float impulse = relativeVelocityX * normal.x + relativeVelocityY * normal.y + relativeVelocityZ * normal.z;
@@ -44,143 +35,74 @@ public:
         float j = -(1.0f + e) * impulse * dampening;
 
         // Apply the impulse to the colliders' velocities
-        a->velocity.x += j * normal.x;
-        a->velocity.y += j * normal.y;
-        a->velocity.z += j * normal.z;
-        b->velocity.x -= j * normal.x;
-        b->velocity.y -= j * normal.y;
-        b->velocity.z -= j * normal.z;
+        store.velocityX[a] += j * normal.x;
+        store.velocityY[a] += j * normal.y;
+        store.velocityZ[a] += j * normal.z;
+        store.velocityX[b] -= j * normal.x;
+        store.velocityY[b] -= j * normal.y;
+        store.velocityZ[b] -= j * normal.z;
     }
 
     // are two colliders colliding?
-    static bool checkCollision(const ColliderObject* a, const ColliderObject* b) {
-        return (std::abs(a->position.x - b->position.x) * 2 < (a->size.x + b->size.x)) &&
-            (std::abs(a->position.y - b->position.y) * 2 < (a->size.y + b->size.y)) &&
-            (std::abs(a->position.z - b->position.z) * 2 < (a->size.z + b->size.z));
+    inline bool checkCollision(const ColliderStore& store, const unsigned int a, const unsigned int b) {
+        return (std::abs(store.positionX[a] - store.positionX[b]) * 2 < (store.sizeX[a] + store.sizeX[b])) &&
+            (std::abs(store.positionY[a] - store.positionY[b]) * 2 < (store.sizeY[a] + store.sizeY[b])) &&
+            (std::abs(store.positionZ[a] - store.positionZ[b]) * 2 < (store.sizeZ[a] + store.sizeZ[b]));
     }
 
-    static bool TestCollision(ColliderObject* a, ColliderObject* b)
+    inline bool TestCollision(ColliderStore& store, const unsigned int a, const unsigned int b)
     {
-        if (checkCollision(a, b)) {
-            resolveCollision(a, b);
+        if (checkCollision(store, a, b)) {
+            resolveCollision(store, a, b);
             return true;
         }
         return false;
     }
 
-    // draw the physics object
-    void draw() {
-        glPushMatrix();
-        glTranslatef(position.x, position.y, position.z);
-        GLfloat diffuseMaterial[] = { colour.x, colour.y, colour.z, 1.0f };
-        glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuseMaterial);
-        glScalef(size.x, size.y, size.z);
-        glRotatef(-90, 1, 0, 0);
-        drawMesh();
-        glPopMatrix();
-    }
-
-    virtual void drawMesh() {};
-
-    void update(const float& deltaTime)
+    inline void update(ColliderStore& store, const unsigned int id, const float& deltaTime)
     {
         const float floorY = minY;
         // Update velocity due to gravity
-        velocity.y += gravity * deltaTime;
+        store.velocityY[id] += gravity * deltaTime;
 
         // Update position based on velocity
-        position.x += velocity.x * deltaTime;
-        position.y += velocity.y * deltaTime;
-        position.z += velocity.z * deltaTime;
+        store.positionX[id] += store.velocityX[id] * deltaTime;
+        store.positionY[id] += store.velocityY[id] * deltaTime;
+        store.positionZ[id] += store.velocityZ[id] * deltaTime;
 
         // Check for collision with the floor
-        if (position.y - size.y / 2.0f < floorY) {
-            position.y = floorY + size.y / 2.0f;
+        if (store.positionY[id] - store.sizeY[id] / 2.0f < floorY) {
+            store.positionY[id] = floorY + store.sizeY[id] / 2.0f;
             float dampening = 0.7f;
-            velocity.y = -velocity.y * dampening;
+            store.velocityY[id] = -store.velocityY[id] * dampening;
         }
 
         // ceiling
-        if (position.y + size.y / 2.0f > maxY) {
-            velocity.y = -velocity.y;
+        if (store.positionY[id] + store.sizeY[id] / 2.0f > maxY) {
+            store.velocityY[id] = -store.velocityY[id];
         }
 
         // Check for collision with the walls
-        if (position.x - size.x / 2.0f < minX || position.x + size.x / 2.0f > maxX) {
-            velocity.x = -velocity.x;
+        if (store.positionX[id] - store.sizeX[id] / 2.0f < minX || store.positionX[id] + store.sizeX[id] / 2.0f > maxX) {
+            store.velocityX[id] = -store.velocityX[id];
         }
-        if (position.z - size.z / 2.0f < minZ || position.z + size.z / 2.0f > maxZ) {
-            velocity.z = -velocity.z;
+        if (store.positionZ[id] - store.sizeZ[id] / 2.0f < minZ || store.positionZ[id] + store.sizeZ[id] / 2.0f > maxZ) {
+            store.velocityZ[id] = -store.velocityZ[id];
         }
-
-        pNext = nullptr;
     }
 
-    void updateCollisions(LinkedVector<ColliderObject*>& colliders) {
-        // Check for collisions with other colliders
-        for (auto it = colliders.begin(); it != colliders.end(); ++it) {
-            ColliderObject* other = *it;
+    // draw the physics object
+    void draw(const ColliderStore& store, const unsigned int id);
 
-            if (this == other) continue;
-            if (TestCollision(this, other)) break;
-        }
-    }
+    // draw the physics object at position rather than where the store has it, for interpolated rendering
+    void draw(const ColliderStore& store, const unsigned int id, const Vec3& position);
 
     // a ray which is used to tap (by default, remove) a box - see the 'mouse' function for how this is used.
-    bool rayBoxIntersection(const Vec3& rayOrigin, const Vec3& rayDirection)
-    {
-        float tMin = (position.x - size.x / 2.0f - rayOrigin.x) / rayDirection.x;
-        float tMax = (position.x + size.x / 2.0f - rayOrigin.x) / rayDirection.x;
-
-        if (tMin > tMax) std::swap(tMin, tMax);
-
-        float tyMin = (position.y - size.y / 2.0f - rayOrigin.y) / rayDirection.y;
-        float tyMax = (position.y + size.y / 2.0f - rayOrigin.y) / rayDirection.y;
-
-        if (tyMin > tyMax) std::swap(tyMin, tyMax);
-
-        if ((tMin > tyMax) || (tyMin > tMax))
-            return false;
+    bool rayBoxIntersection(const ColliderStore& store, const unsigned int id, const Vec3& rayOrigin, const Vec3& rayDirection);
 
-        if (tyMin > tMin)
-            tMin = tyMin;
-
-        if (tyMax < tMax)
-            tMax = tyMax;
-
-        float tzMin = (position.z - size.z / 2.0f - rayOrigin.z) / rayDirection.z;
-        float tzMax = (position.z + size.z / 2.0f - rayOrigin.z) / rayDirection.z;
-
-        if (tzMin > tzMax) std::swap(tzMin, tzMax);
-
-        if ((tMin > tzMax) || (tzMin > tMax))
-            return false;
-
-        return true;
-    }
-
-    template<class ColliderType>
-    static ColliderObject* createCollider()
-    {
-        ColliderObject* obj = new ColliderType();
-
-        // Assign random x, y, and z positions within specified ranges
-        obj->position.x = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 20.0f));
-        obj->position.y = 10.0f + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 1.0f));
-        obj->position.z = static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 20.0f));
-
-        obj->size = { 1.0f, 1.0f, 1.0f };
-
-        // Assign random x-velocity between -1.0f and 1.0f
-        float randomXVelocity = -1.0f + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 2.0f));
-        obj->velocity = { randomXVelocity, 0.0f, 0.0f };
-
-        // Assign a random color to the box
-        obj->colour.x = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        obj->colour.y = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        obj->colour.z = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-
-        return obj;
-    }
-};
+    // seeds the generator createCollider uses, the same seed gives the same bodies
+    void seedRandom(const unsigned int seed);
 
+    // adds a body with random position, velocity and colour to the store
+    unsigned int createCollider(ColliderStore& store, const ColliderType type);
+}
@@ -0,0 +1,193 @@
+#include "ColliderStore.h"
+#include "MemoryOperators.h"
+#include <cstdint>
+#include <cstring>
+
+#ifdef _DEBUG
+#include "TrackerIndex.h"
+#endif
+
+namespace
+{
+	/// <summary>
+	/// Allocates an array aligned to ColliderStore::alignment, the pointer returned by new
+	/// is stored just before the aligned array so it can be given back to delete
+	/// </summary>
+	template<class T>
+	T* AllocateArray(const size_t count)
+	{
+		const size_t bytes = (count * sizeof(T)) + ColliderStore::alignment + sizeof(void*);
+#ifdef _DEBUG
+		void* raw = ::operator new(bytes, MemoryManager::TrackerIndex::Collider);
+#else
+		void* raw = ::operator new(bytes);
+#endif
+		uintptr_t aligned = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+		aligned = (aligned + ColliderStore::alignment - 1) & ~(uintptr_t)(ColliderStore::alignment - 1);
+
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		std::memset(reinterpret_cast<void*>(aligned), 0, count * sizeof(T));
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	template<class T>
+	void FreeArray(T* ptr)
+	{
+		if (ptr == nullptr) return;
+		::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+	}
+
+	template<class T>
+	void GrowArray(T*& ptr, const size_t count, const size_t capacity)
+	{
+		T* grown = AllocateArray<T>(capacity);
+		if (ptr != nullptr)
+		{
+			std::memcpy(grown, ptr, count * sizeof(T));
+			FreeArray(ptr);
+		}
+		ptr = grown;
+	}
+}
+
+ColliderStore::ColliderStore(const size_t capacity)
+{
+	Reserve(capacity != 0 ? capacity : batchWidth);
+}
+
+ColliderStore::~ColliderStore()
+{
+	FreeArray(positionX);
+	FreeArray(positionY);
+	FreeArray(positionZ);
+	FreeArray(velocityX);
+	FreeArray(velocityY);
+	FreeArray(velocityZ);
+	FreeArray(sizeX);
+	FreeArray(sizeY);
+	FreeArray(sizeZ);
+	FreeArray(colourX);
+	FreeArray(colourY);
+	FreeArray(colourZ);
+	FreeArray(type);
+	FreeArray(asleep);
+	FreeArray(restTime);
+}
+
+unsigned int ColliderStore::Add(const ColliderType colliderType)
+{
+	if (count == capacity)
+	{
+		Reserve(capacity * 2);
+	}
+
+	const unsigned int id = count++;
+	positionX[id] = positionY[id] = positionZ[id] = 0.0f;
+	velocityX[id] = velocityY[id] = velocityZ[id] = 0.0f;
+	sizeX[id] = sizeY[id] = sizeZ[id] = 0.0f;
+	colourX[id] = colourY[id] = colourZ[id] = 0.0f;
+	type[id] = colliderType;
+	asleep[id] = 0;
+	restTime[id] = 0.0f;
+	return id;
+}
+
+void ColliderStore::Remove(const unsigned int id)
+{
+	if (id >= count) return;
+
+	const unsigned int last = --count;
+	if (id != last)
+	{
+		positionX[id] = positionX[last];
+		positionY[id] = positionY[last];
+		positionZ[id] = positionZ[last];
+		velocityX[id] = velocityX[last];
+		velocityY[id] = velocityY[last];
+		velocityZ[id] = velocityZ[last];
+		sizeX[id] = sizeX[last];
+		sizeY[id] = sizeY[last];
+		sizeZ[id] = sizeZ[last];
+		colourX[id] = colourX[last];
+		colourY[id] = colourY[last];
+		colourZ[id] = colourZ[last];
+		type[id] = type[last];
+	}
+
+	// keep the padding past count zeroed so batched kernels read harmless values
+	positionX[last] = positionY[last] = positionZ[last] = 0.0f;
+	velocityX[last] = velocityY[last] = velocityZ[last] = 0.0f;
+	sizeX[last] = sizeY[last] = sizeZ[last] = 0.0f;
+
+	// bodies resting on the removed one would otherwise hang in the air, and the moved
+	// body's sleep links and cached octant belong to its old id
+	WakeAll();
+	asleep[last] = 0;
+	restTime[last] = 0.0f;
+}
+
+void ColliderStore::WakeAll()
+{
+	std::memset(asleep, 0, count * sizeof(unsigned char));
+	std::memset(restTime, 0, count * sizeof(float));
+}
+
+void ColliderStore::CopyDrawState(const ColliderStore& other)
+{
+	// nothing here needs keeping, so drop it before growing to skip copying it
+	count = 0;
+	Reserve(other.count);
+
+	const size_t floatBytes = other.count * sizeof(float);
+	std::memcpy(positionX, other.positionX, floatBytes);
+	std::memcpy(positionY, other.positionY, floatBytes);
+	std::memcpy(positionZ, other.positionZ, floatBytes);
+	std::memcpy(sizeX, other.sizeX, floatBytes);
+	std::memcpy(sizeY, other.sizeY, floatBytes);
+	std::memcpy(sizeZ, other.sizeZ, floatBytes);
+	std::memcpy(colourX, other.colourX, floatBytes);
+	std::memcpy(colourY, other.colourY, floatBytes);
+	std::memcpy(colourZ, other.colourZ, floatBytes);
+	std::memcpy(type, other.type, other.count * sizeof(ColliderType));
+	count = other.count;
+}
+
+uint64_t ColliderStore::Hash() const
+{
+	// FNV-1a over the raw bytes of each array in turn
+	uint64_t hash = 14695981039346656037ull;
+	const float* arrays[] = { positionX, positionY, positionZ, velocityX, velocityY, velocityZ };
+	for (const float* array : arrays)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(array);
+		for (size_t i = 0; i < count * sizeof(float); ++i)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+void ColliderStore::Reserve(size_t newCapacity)
+{
+	// round up to a whole number of batches
+	newCapacity = (newCapacity + batchWidth - 1) & ~(batchWidth - 1);
+	if (newCapacity <= capacity) return;
+
+	GrowArray(positionX, count, newCapacity);
+	GrowArray(positionY, count, newCapacity);
+	GrowArray(positionZ, count, newCapacity);
+	GrowArray(velocityX, count, newCapacity);
+	GrowArray(velocityY, count, newCapacity);
+	GrowArray(velocityZ, count, newCapacity);
+	GrowArray(sizeX, count, newCapacity);
+	GrowArray(sizeY, count, newCapacity);
+	GrowArray(sizeZ, count, newCapacity);
+	GrowArray(colourX, count, newCapacity);
+	GrowArray(colourY, count, newCapacity);
+	GrowArray(colourZ, count, newCapacity);
+	GrowArray(type, count, newCapacity);
+	GrowArray(asleep, count, newCapacity);
+	GrowArray(restTime, count, newCapacity);
+	capacity = newCapacity;
+}
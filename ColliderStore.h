@@ -0,0 +1,89 @@
+#pragma once
+#include "Vec3.h"
+#include <cstddef>
+#include <cstdint>
+
+enum class ColliderType : unsigned char
+{
+	Box,
+	Sphere
+};
+
+/// <summary>
+/// Structure of arrays storage for every collider in the scene, each body is referred to by a dense id.
+/// Every array is aligned and padded so kernels can always work on whole batches
+/// </summary>
+class ColliderStore
+{
+public:
+	static constexpr unsigned int nullId = ~0u;
+	static constexpr size_t alignment = 32; // alignment of every array, enough for 8 floats
+	static constexpr size_t batchWidth = alignment / sizeof(float); // capacity is always a multiple of this
+
+	ColliderStore(const size_t capacity = 0);
+	~ColliderStore();
+
+	ColliderStore(const ColliderStore&) = delete;
+	ColliderStore& operator=(const ColliderStore&) = delete;
+
+	/// <summary>
+	/// Adds a zeroed body of given type to the end of the store
+	/// </summary>
+	/// <returns>id of the new body</returns>
+	unsigned int Add(const ColliderType type);
+
+	/// <summary>
+	/// Removes a body by moving the last body into its slot, so ids stay dense.
+	/// Sleep state is kept by id and may have been resting on the removed body, so every body is woken
+	/// </summary>
+	void Remove(const unsigned int id);
+
+	/// <summary>
+	/// Wakes every body, they all have to rest for timeToSleep again before they can sleep
+	/// </summary>
+	void WakeAll();
+
+	/// <summary>
+	/// Makes this store hold other's bodies as far as drawing them goes, their positions, sizes, colours and types.
+	/// Velocities and sleep state are left as they were, and the arrays only grow when other has more bodies than fit
+	/// </summary>
+	void CopyDrawState(const ColliderStore& other);
+
+	void Reserve(size_t capacity);
+
+	inline unsigned int Count() const { return count; }
+	inline size_t Capacity() const { return capacity; }
+
+	/// <summary>
+	/// Hash of every body's position and velocity bits, two runs are identical if their hashes match
+	/// </summary>
+	uint64_t Hash() const;
+
+	inline Vec3 Position(const unsigned int id) const { return Vec3(positionX[id], positionY[id], positionZ[id]); }
+	inline Vec3 Size(const unsigned int id) const { return Vec3(sizeX[id], sizeY[id], sizeZ[id]); }
+
+	float* positionX = nullptr;
+	float* positionY = nullptr;
+	float* positionZ = nullptr;
+
+	float* velocityX = nullptr;
+	float* velocityY = nullptr;
+	float* velocityZ = nullptr;
+
+	float* sizeX = nullptr;
+	float* sizeY = nullptr;
+	float* sizeZ = nullptr;
+
+	float* colourX = nullptr;
+	float* colourY = nullptr;
+	float* colourZ = nullptr;
+
+	ColliderType* type = nullptr;
+
+	unsigned char* asleep = nullptr; // 1 while a body is asleep, sleeping bodies are neither integrated nor moved
+	float* restTime = nullptr; // seconds a body has been slower than sleepVelocity
+
+private:
+	unsigned int count = 0;
+	size_t capacity = 0;
+};
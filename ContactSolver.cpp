@@ -0,0 +1,106 @@
+#include "ContactSolver.h"
+#include "ColliderObject.h"
+#include "ColliderStore.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	// index of the lowest set bit, mask must not be 0
+	inline unsigned int LowestBit(const uint64_t mask)
+	{
+		unsigned int bit = 0;
+		while (!(mask & (1ull << bit))) ++bit;
+		return bit;
+	}
+}
+
+void ContactSolver::BuildBatches(const unsigned int bodyCount, const CollisionPair* contacts, const unsigned int contactCount)
+{
+	if (bodyColours.size() < bodyCount)
+	{
+		bodyColours.resize(bodyCount, 0);
+	}
+
+	// colour each contact, counting the contacts of each colour as we go
+	// (the final count is for contacts that didn't get a colour)
+	unsigned int counts[maxColours + 1] = {};
+	contactColours.resize(contactCount);
+	for (unsigned int i = 0; i < contactCount; ++i)
+	{
+		const CollisionPair& contact = contacts[i];
+		const uint64_t used = bodyColours[contact.a] | bodyColours[contact.b];
+
+		unsigned int colour = maxColours;
+		if (used != ~0ull)
+		{
+			colour = LowestBit(~used);
+			bodyColours[contact.a] |= 1ull << colour;
+			bodyColours[contact.b] |= 1ull << colour;
+		}
+		contactColours[i] = static_cast<unsigned char>(colour);
+		++counts[colour];
+	}
+
+	hasUncoloured = counts[maxColours] != 0;
+
+	// prefix sum the counts in to batch offsets, skipping unused colours
+	batchOffsets.clear();
+	batchOffsets.push_back(0);
+	unsigned int starts[maxColours + 1];
+	for (unsigned int colour = 0; colour <= maxColours; ++colour)
+	{
+		starts[colour] = batchOffsets.back();
+		if (counts[colour] != 0)
+		{
+			batchOffsets.push_back(batchOffsets.back() + counts[colour]);
+		}
+	}
+
+	// scatter the contacts in to their batches, keeping their order within a batch
+	batched.resize(contactCount);
+	for (unsigned int i = 0; i < contactCount; ++i)
+	{
+		batched[starts[contactColours[i]]++] = contacts[i];
+	}
+
+	// only the touched bodies need clearing for the next frame
+	for (unsigned int i = 0; i < contactCount; ++i)
+	{
+		bodyColours[contacts[i].a] = 0;
+		bodyColours[contacts[i].b] = 0;
+	}
+}
+
+void ContactSolver::Solve(ColliderStore& colliders, const CollisionPair* contacts, const unsigned int contactCount, ThreadPool& workers)
+{
+	BuildBatches(colliders.Count(), contacts, contactCount);
+
+	for (unsigned int batch = 0; batch < BatchCount(); ++batch)
+	{
+		const unsigned int begin = batchOffsets[batch];
+		const unsigned int count = batchOffsets[batch + 1] - begin;
+		// the uncoloured batch is always last, it has to be resolved serially
+		const bool serial = count < parallelThreshold || (hasUncoloured && batch == BatchCount() - 1);
+
+		if (serial)
+		{
+			SolveSerial(colliders, batched.data() + begin, count);
+		}
+		else
+		{
+			// no two contacts in a batch share a body, so no locks are needed
+			workers.ParallelFor(count, parallelThreshold / 4, [&](const unsigned int index, const unsigned int) {
+				const CollisionPair& contact = batched[begin + index];
+				ColliderObject::resolveCollision(colliders, contact.a, contact.b);
+				});
+		}
+	}
+}
+
+void ContactSolver::SolveSerial(ColliderStore& colliders, const CollisionPair* contacts, const unsigned int contactCount)
+{
+	for (unsigned int i = 0; i < contactCount; ++i)
+	{
+		ColliderObject::resolveCollision(colliders, contacts[i].a, contacts[i].b);
+	}
+}
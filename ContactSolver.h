@@ -0,0 +1,49 @@
+#pragma once
+#include "NarrowPhase.h"
+#include <cstdint>
+#include <vector>
+
+class ColliderStore;
+class ThreadPool;
+
+/// <summary>
+/// Resolves contacts in parallel without locks. Contacts are coloured into batches where no body
+/// appears twice, so every contact in a batch can be resolved at the same time
+/// </summary>
+class ContactSolver
+{
+public:
+	// batches smaller than this are resolved on the calling thread
+	static constexpr unsigned int parallelThreshold = 256;
+
+	// islands with fewer contacts than this are resolved serially as one task, as colouring
+	// them would only give batches below parallelThreshold
+	static constexpr unsigned int splitThreshold = 2048;
+
+	/// <summary>
+	/// Resolves every contact, batch by batch, using the pool's threads
+	/// </summary>
+	void Solve(ColliderStore& colliders, const CollisionPair* contacts, const unsigned int contactCount, ThreadPool& workers);
+
+	/// <summary>
+	/// Resolves contacts one after another on the calling thread
+	/// </summary>
+	static void SolveSerial(ColliderStore& colliders, const CollisionPair* contacts, const unsigned int contactCount);
+
+	inline unsigned int BatchCount() const { return static_cast<unsigned int>(batchOffsets.size()) - 1; }
+
+private:
+	static constexpr unsigned int maxColours = 64; // one bit per colour in a body's mask
+
+	/// <summary>
+	/// Greedy colouring, each contact takes the lowest colour neither of its bodies uses yet.
+	/// Contacts that find no free colour go in a final batch that is resolved serially
+	/// </summary>
+	void BuildBatches(const unsigned int bodyCount, const CollisionPair* contacts, const unsigned int contactCount);
+
+	std::vector<uint64_t> bodyColours; // colours used by each body, kept zeroed between frames
+	std::vector<unsigned char> contactColours;
+	std::vector<CollisionPair> batched; // contacts sorted by colour
+	std::vector<unsigned int> batchOffsets; // batch i is [batchOffsets[i], batchOffsets[i + 1]) of batched
+	bool hasUncoloured = false;
+};
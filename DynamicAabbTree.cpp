@@ -0,0 +1,417 @@
+#include "DynamicAabbTree.h"
+#include "ColliderStore.h"
+#include <cstdlib>
+#include "MemoryOperators.h"
+#include "TrackerIndex.h"
+
+constexpr unsigned int DynamicAabbTree::noBody;
+constexpr float DynamicAabbTree::fatMargin;
+constexpr unsigned int DynamicAabbTree::reinsertBudget;
+constexpr unsigned int DynamicAabbTree::bodySliceSize;
+
+namespace
+{
+	using PhysicsKernels::Bounds;
+
+	inline Bounds Merged(Bounds a, const Bounds& b)
+	{
+		a.Merge(b);
+		return a;
+	}
+
+	inline float SurfaceArea(const Bounds& bounds)
+	{
+		const float x = bounds.maxX - bounds.minX;
+		const float y = bounds.maxY - bounds.minY;
+		const float z = bounds.maxZ - bounds.minZ;
+		return 2.0f * (x * y + y * z + z * x);
+	}
+
+	inline bool Contains(const Bounds& outer, const Bounds& inner)
+	{
+		return outer.minX <= inner.minX && outer.minY <= inner.minY && outer.minZ <= inner.minZ &&
+			inner.maxX <= outer.maxX && inner.maxY <= outer.maxY && inner.maxZ <= outer.maxZ;
+	}
+
+	inline Bounds Fattened(const Bounds& bounds)
+	{
+		const float margin = DynamicAabbTree::fatMargin;
+		return Bounds{
+			bounds.minX - margin, bounds.minY - margin, bounds.minZ - margin,
+			bounds.maxX + margin, bounds.maxY + margin, bounds.maxZ + margin
+		};
+	}
+}
+
+DynamicAabbTree::DynamicAabbTree(ThreadPool& pool, ColliderStore& colliders) :
+	Broadphase(pool, colliders)
+{
+}
+
+DynamicAabbTree::~DynamicAabbTree()
+{
+	DeleteSubtree(pRoot);
+}
+
+void DynamicAabbTree::DeleteSubtree(Node* pNode)
+{
+	if (pNode == nullptr) return;
+
+	DeleteSubtree(pNode->children[0]);
+	DeleteSubtree(pNode->children[1]);
+	delete pNode;
+}
+
+void DynamicAabbTree::BeginBuild()
+{
+	SizeBins();
+	binMoved.resize(binCount);
+	bodyBounds.resize(bodyCount);
+}
+
+void DynamicAabbTree::CountBin(const unsigned int bin)
+{
+	// each body has its own leaf, so leaves can be grown from any thread. Bodies added this step get theirs later
+	std::vector<unsigned int>& binLeaves = binMoved[bin];
+	binLeaves.clear();
+	const unsigned int leafCount = static_cast<unsigned int>(leaves.size());
+	for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
+	{
+		const Bounds bounds = Bounds::FromStore(colliders, id);
+		bodyBounds[id] = bounds;
+		if (id < leafCount && !Contains(leaves[id]->bounds, bounds))
+		{
+			leaves[id]->bounds = Fattened(bounds);
+			binLeaves.push_back(id);
+		}
+	}
+}
+
+void DynamicAabbTree::PrefixSum()
+{
+	moved.clear();
+	for (const std::vector<unsigned int>& binLeaves : binMoved)
+	{
+		moved.insert(moved.end(), binLeaves.begin(), binLeaves.end());
+	}
+
+	// grown leaves are still where they were, their ancestors just need growing to fit them again
+	if (!moved.empty())
+	{
+		Refit();
+	}
+
+	// removing a body moves the last one into its place, so only leaves past the end are gone
+	while (leaves.size() > bodyCount)
+	{
+		RemoveLeaf(leaves.back());
+		delete leaves.back();
+		leaves.pop_back();
+	}
+	for (unsigned int id = static_cast<unsigned int>(leaves.size()); id < bodyCount; ++id)
+	{
+		Node* pLeaf = new Node(Fattened(bodyBounds[id]), id);
+		InsertLeaf(pLeaf);
+		leaves.push_back(pLeaf);
+	}
+
+	// a leaf left where it was made keeps its ancestors large as its body moves away, so grown leaves are moved
+	// to where they fit best, taking turns when there are too many to move in one step
+	const unsigned int movedCount = static_cast<unsigned int>(moved.size());
+	const unsigned int reinsertCount = std::min(movedCount, reinsertBudget);
+	const unsigned int start = movedCount > 0 ? reinsertCursor % movedCount : 0;
+	for (unsigned int i = 0; i < reinsertCount; ++i)
+	{
+		Node* pLeaf = leaves[moved[(start + i) % movedCount]];
+		RemoveLeaf(pLeaf);
+		InsertLeaf(pLeaf);
+	}
+	reinsertCursor = start + reinsertCount;
+}
+
+void DynamicAabbTree::Refit()
+{
+	// a node is always taller than its children, so refitting one height at a time never reads a stale child
+	if (topologyChanged)
+	{
+		for (std::vector<Node*>& nodes : heightNodes)
+		{
+			nodes.clear();
+		}
+		heightNodes.resize(static_cast<size_t>(Height()) + 1);
+
+		thread_local std::vector<Node*> stack;
+		stack.clear();
+		if (pRoot != nullptr)
+		{
+			stack.push_back(pRoot);
+		}
+		while (!stack.empty())
+		{
+			Node* pNode = stack.back();
+			stack.pop_back();
+			if (pNode->IsLeaf()) continue;
+
+			heightNodes[pNode->height].push_back(pNode);
+			stack.push_back(pNode->children[0]);
+			stack.push_back(pNode->children[1]);
+		}
+		topologyChanged = false;
+	}
+
+	for (size_t height = 1; height < heightNodes.size(); ++height)
+	{
+		std::vector<Node*>& nodes = heightNodes[height];
+		pool.ParallelForRange(static_cast<unsigned int>(nodes.size()), 64,
+			[&nodes](const unsigned int begin, const unsigned int end, const unsigned int) {
+				for (unsigned int i = begin; i < end; ++i)
+				{
+					nodes[i]->bounds = Merged(nodes[i]->children[0]->bounds, nodes[i]->children[1]->bounds);
+				}
+			});
+	}
+}
+
+void DynamicAabbTree::InsertLeaf(Node* pLeaf)
+{
+	++nodeCount;
+	topologyChanged = true;
+	pLeaf->pParent = nullptr;
+	if (pRoot == nullptr)
+	{
+		pRoot = pLeaf;
+		return;
+	}
+
+	// walk down towards the sibling that adds least surface area to the tree, stopping once
+	// making a new parent here is cheaper than pushing the leaf further down either side
+	const Bounds& bounds = pLeaf->bounds;
+	Node* pSibling = pRoot;
+	while (!pSibling->IsLeaf())
+	{
+		const float area = SurfaceArea(pSibling->bounds);
+		const float combinedArea = SurfaceArea(Merged(pSibling->bounds, bounds));
+		const float parentCost = 2.0f * combinedArea;
+		const float inheritedCost = 2.0f * (combinedArea - area); // every ancestor grows by this much if the leaf goes lower
+
+		float childCosts[2];
+		for (int i = 0; i < 2; i++)
+		{
+			const Node* pChild = pSibling->children[i];
+			const float childArea = SurfaceArea(Merged(pChild->bounds, bounds));
+			childCosts[i] = inheritedCost + (pChild->IsLeaf() ? childArea : childArea - SurfaceArea(pChild->bounds));
+		}
+
+		if (parentCost < childCosts[0] && parentCost < childCosts[1]) break;
+		pSibling = pSibling->children[childCosts[0] < childCosts[1] ? 0 : 1];
+	}
+
+	Node* pParent = new Node(Merged(pSibling->bounds, bounds), noBody);
+	++nodeCount;
+	Replace(pSibling, pParent);
+	pParent->pParent = pSibling->pParent;
+	pParent->children[0] = pSibling;
+	pParent->children[1] = pLeaf;
+	pParent->height = pSibling->height + 1;
+	pSibling->pParent = pParent;
+	pLeaf->pParent = pParent;
+
+	FixUpwards(pParent);
+}
+
+void DynamicAabbTree::RemoveLeaf(Node* pLeaf)
+{
+	--nodeCount;
+	topologyChanged = true;
+	if (pLeaf == pRoot)
+	{
+		pRoot = nullptr;
+		return;
+	}
+
+	// the leaf's sibling takes its parent's place
+	Node* pParent = pLeaf->pParent;
+	Node* pSibling = pParent->children[pParent->children[0] == pLeaf ? 1 : 0];
+	Replace(pParent, pSibling);
+	pSibling->pParent = pParent->pParent;
+	pLeaf->pParent = nullptr;
+	delete pParent;
+	--nodeCount;
+
+	FixUpwards(pSibling->pParent);
+}
+
+void DynamicAabbTree::FixUpwards(Node* pNode)
+{
+	while (pNode != nullptr)
+	{
+		pNode = Balance(pNode);
+		FitNode(pNode);
+		pNode = pNode->pParent;
+	}
+}
+
+DynamicAabbTree::Node* DynamicAabbTree::Balance(Node* pNode)
+{
+	if (pNode->IsLeaf() || pNode->height < 2) return pNode;
+
+	const int difference = pNode->children[1]->height - pNode->children[0]->height;
+	if (std::abs(difference) <= 1) return pNode;
+
+	// the taller child takes pNode's place, with pNode and the taller of its own children below it.
+	// Its shorter child is given to pNode in its place
+	const int taller = difference > 0 ? 1 : 0;
+	Node* pRising = pNode->children[taller];
+	Node* pFirst = pRising->children[0];
+	Node* pSecond = pRising->children[1];
+	Node* pKept = pFirst->height > pSecond->height ? pFirst : pSecond;
+	Node* pGiven = pKept == pFirst ? pSecond : pFirst;
+
+	Replace(pNode, pRising);
+	pRising->pParent = pNode->pParent;
+	pRising->children[0] = pNode;
+	pRising->children[1] = pKept;
+	pNode->pParent = pRising;
+	pNode->children[taller] = pGiven;
+	pGiven->pParent = pNode;
+
+	FitNode(pNode);
+	FitNode(pRising);
+	return pRising;
+}
+
+void DynamicAabbTree::Replace(Node* pOld, Node* pNew)
+{
+	Node* pParent = pOld->pParent;
+	if (pParent == nullptr)
+	{
+		pRoot = pNew;
+	}
+	else
+	{
+		pParent->children[pParent->children[0] == pOld ? 0 : 1] = pNew;
+	}
+}
+
+void DynamicAabbTree::FitNode(Node* pNode)
+{
+	if (pNode->IsLeaf()) return;
+
+	pNode->bounds = Merged(pNode->children[0]->bounds, pNode->children[1]->bounds);
+	pNode->height = 1 + std::max(pNode->children[0]->height, pNode->children[1]->height);
+}
+
+unsigned int DynamicAabbTree::GatherRegions()
+{
+	regionCount = (bodyCount + bodySliceSize - 1) / bodySliceSize;
+	return regionCount;
+}
+
+void DynamicAabbTree::FindRegionPairs(const unsigned int region, std::vector<CollisionPair>& pairs) const
+{
+	if (pRoot == nullptr) return;
+
+	// sleeping bodies never look, as two sleeping bodies have already settled against each other so are never paired.
+	// Awake bodies look for sleeping ones and awake ones of higher id, which find them in their fat leaves
+	// as their own bounds lie inside them
+	thread_local std::vector<const Node*> stack;
+	const unsigned int end = std::min((region + 1) * bodySliceSize, bodyCount);
+	for (unsigned int id = region * bodySliceSize; id < end; ++id)
+	{
+		if (colliders.asleep[id] != 0) continue;
+
+		const Bounds& bounds = bodyBounds[id];
+		if (!pRoot->bounds.Overlaps(bounds)) continue;
+
+		stack.clear();
+		stack.push_back(pRoot);
+		while (!stack.empty())
+		{
+			const Node* pNode = stack.back();
+			stack.pop_back();
+			if (pNode->IsLeaf())
+			{
+				const unsigned int other = pNode->body;
+				if ((other > id || colliders.asleep[other] != 0) && other != id && bodyBounds[other].Overlaps(bounds))
+				{
+					pairs.push_back(CollisionPair{ id, other });
+				}
+				continue;
+			}
+
+			for (const Node* pChild : pNode->children)
+			{
+				if (pChild->bounds.Overlaps(bounds))
+				{
+					stack.push_back(pChild);
+				}
+			}
+		}
+	}
+}
+
+void DynamicAabbTree::QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const
+{
+	if (pRoot == nullptr) return;
+
+	// leaves are tested against the store rather than last step's bounds, in case bodies were moved since
+	thread_local std::vector<const Node*> stack;
+	stack.clear();
+	stack.push_back(pRoot);
+	const unsigned int count = colliders.Count();
+	while (!stack.empty())
+	{
+		const Node* pNode = stack.back();
+		stack.pop_back();
+		if (!pNode->bounds.Overlaps(bounds)) continue;
+
+		if (!pNode->IsLeaf())
+		{
+			stack.push_back(pNode->children[0]);
+			stack.push_back(pNode->children[1]);
+		}
+		else if (pNode->body < count && Bounds::FromStore(colliders, pNode->body).Overlaps(bounds))
+		{
+			ids.push_back(pNode->body);
+		}
+	}
+}
+
+void DynamicAabbTree::QueryRay(const Vec3& origin, const Vec3& direction, std::vector<unsigned int>& ids) const
+{
+	if (pRoot == nullptr) return;
+
+	const Vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	thread_local std::vector<const Node*> stack;
+	stack.clear();
+	stack.push_back(pRoot);
+	const unsigned int count = colliders.Count();
+	while (!stack.empty())
+	{
+		const Node* pNode = stack.back();
+		stack.pop_back();
+		if (!RayHits(pNode->bounds, origin, inverseDirection)) continue;
+
+		if (!pNode->IsLeaf())
+		{
+			stack.push_back(pNode->children[0]);
+			stack.push_back(pNode->children[1]);
+		}
+		else if (pNode->body < count && RayHits(Bounds::FromStore(colliders, pNode->body), origin, inverseDirection))
+		{
+			ids.push_back(pNode->body);
+		}
+	}
+}
+
+#ifdef _DEBUG
+void* DynamicAabbTree::Node::operator new(size_t size)
+{
+	return ::operator new(size, MemoryManager::TrackerIndex::AabbNode);
+}
+#endif
+
+DynamicAabbTree::Node::Node(const PhysicsKernels::Bounds& bounds, const unsigned int body) :
+	bounds(bounds), pParent(nullptr), children{ nullptr, nullptr }, body(body), height(0)
+{
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "Broadphase.h"
+#include <vector>
+
+/// <summary>
+/// Dynamic bounding volume hierarchy broadphase. Every body has a leaf whose bounds are its own grown by
+/// fatMargin, so a leaf only needs touching once its body leaves them. Bodies are inserted next to the
+/// sibling that grows the tree's surface area least, and the tree is kept balanced with rotations on the
+/// way back up. Unlike the Octree it has no fixed extent, so it fits any world size and any mix of body
+/// sizes
+/// </summary>
+class DynamicAabbTree : public Broadphase
+{
+public:
+	struct Node
+	{
+		PhysicsKernels::Bounds bounds; // fat bounds of the body for a leaf, of both children otherwise
+		Node* pParent;
+		Node* children[2];
+		unsigned int body; // noBody unless a leaf
+		int height; // 0 for a leaf
+
+#ifdef _DEBUG
+		void* operator new (size_t size);
+#endif
+
+		Node(const PhysicsKernels::Bounds& bounds, const unsigned int body);
+
+		inline bool IsLeaf() const { return children[0] == nullptr; }
+	};
+
+	static constexpr unsigned int noBody = ~0u;
+	static constexpr float fatMargin = 0.2f; // how far a body can move from where its leaf was made before it is moved
+	static constexpr unsigned int reinsertBudget = 256; // most leaves moved to a better place in the tree each step
+	static constexpr unsigned int bodySliceSize = 64; // bodies whose pairs are found by one region task
+
+	DynamicAabbTree(ThreadPool& pool, ColliderStore& colliders);
+	~DynamicAabbTree();
+
+	/// <summary>
+	/// Sizes the bins for the bodies in the store
+	/// </summary>
+	void BeginBuild() override;
+
+	/// <summary>
+	/// Finds the bounds of each body in the bin, and grows the leaf of any body that left it in place
+	/// </summary>
+	void CountBin(const unsigned int bin) override;
+
+	/// <summary>
+	/// Refits the tree around the grown leaves, adds and removes the leaves of bodies added or removed
+	/// since the last step, then moves some of the grown leaves to where they fit best
+	/// </summary>
+	void PrefixSum() override;
+
+	/// <summary>
+	/// Splits the bodies into regions of bodySliceSize bodies
+	/// </summary>
+	/// <returns>number of regions</returns>
+	unsigned int GatherRegions() override;
+	inline unsigned int RegionCount() const override { return regionCount; }
+
+	/// <summary>
+	/// Emits the pairs of each body in the region with the bodies of higher id whose bounds it overlaps
+	/// </summary>
+	void FindRegionPairs(const unsigned int region, std::vector<CollisionPair>& pairs) const override;
+
+	/// <summary>
+	/// Walks the leaves whose fat bounds overlap bounds
+	/// </summary>
+	void QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const override;
+
+	/// <summary>
+	/// Walks the leaves whose fat bounds the ray passes through
+	/// </summary>
+	void QueryRay(const Vec3& origin, const Vec3& direction, std::vector<unsigned int>& ids) const override;
+
+	inline const char* Name() const override { return "aabb tree"; }
+
+	inline int Height() const { return pRoot != nullptr ? pRoot->height : 0; }
+	inline unsigned int NodeCount() const { return nodeCount; }
+
+private:
+	Node* pRoot = nullptr;
+	unsigned int nodeCount = 0;
+	std::vector<Node*> leaves; // leaf of each body
+	std::vector<PhysicsKernels::Bounds> bodyBounds; // bounds of every body this step
+
+	// leaves grown in place this step by each bin, in id order
+	std::vector<std::vector<unsigned int>> binMoved;
+	std::vector<unsigned int> moved;
+	unsigned int reinsertCursor = 0; // where in the grown leaves the next step's reinserting starts
+
+	// internal nodes by height, so each height can be refit in parallel once the one below is done
+	std::vector<std::vector<Node*>> heightNodes;
+	bool topologyChanged = true; // heightNodes needs gathering again
+
+	unsigned int regionCount = 0;
+
+	void Refit();
+	void InsertLeaf(Node* pLeaf);
+	void RemoveLeaf(Node* pLeaf);
+
+	/// <summary>
+	/// Recomputes the bounds and height of each node from pNode up to the root, rotating where unbalanced
+	/// </summary>
+	void FixUpwards(Node* pNode);
+
+	/// <summary>
+	/// Rotates the taller grandchild of an unbalanced node up into its place
+	/// </summary>
+	/// <returns>node now in pNode's place</returns>
+	Node* Balance(Node* pNode);
+	void Replace(Node* pOld, Node* pNew);
+	void FitNode(Node* pNode);
+	void DeleteSubtree(Node* pNode);
+};
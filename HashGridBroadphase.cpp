@@ -0,0 +1,174 @@
+#include "HashGridBroadphase.h"
+#include "ColliderStore.h"
+#include <cmath>
+
+HashGridBroadphase::HashGridBroadphase(ThreadPool& pool, ColliderStore& colliders, const Vec3 minimum, const Vec3 maximum) :
+	Broadphase(pool, colliders), minimum(minimum), maximum(maximum)
+{
+}
+
+void HashGridBroadphase::BeginBuild()
+{
+	SizeBins();
+
+	// bodies never change size once made, so the cells only need sizing when bodies come or go
+	if (sizedCount != bodyCount)
+	{
+		SizeCells();
+		sizedCount = bodyCount;
+	}
+
+	sortEntries.resize(bodyCount);
+	members.resize(bodyCount);
+}
+
+void HashGridBroadphase::SizeCells()
+{
+	float largest = 0.0f;
+	for (unsigned int id = 0; id < colliders.Count(); ++id)
+	{
+		largest = std::max(largest, std::max(colliders.sizeX[id], std::max(colliders.sizeY[id], colliders.sizeZ[id])));
+	}
+
+	// a hair wider than the largest body, so rounding can't leave two touching bodies two cells apart
+	cellSize = largest > 0.0f ? largest * 1.001f : 1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		dimensions[i] = std::max(1u, static_cast<unsigned int>(std::ceil((maximum[i] - minimum[i]) / cellSize)));
+		keyBits[i] = 0;
+		while ((dimensions[i] - 1) >> keyBits[i])
+		{
+			++keyBits[i];
+		}
+	}
+}
+
+uint64_t HashGridBroadphase::CellKey(const unsigned int x, const unsigned int y, const unsigned int z) const
+{
+	return (static_cast<uint64_t>(z) << (keyBits[0] + keyBits[1])) | (static_cast<uint64_t>(y) << keyBits[0]) | x;
+}
+
+unsigned int HashGridBroadphase::CellCoordinate(const float position, const int axis) const
+{
+	// clamping to the grid keeps neighbouring bodies outside of it in neighbouring cells
+	const float offset = std::floor((position - minimum[axis]) / cellSize);
+	return static_cast<unsigned int>(std::min(std::max(offset, 0.0f), static_cast<float>(dimensions[axis] - 1)));
+}
+
+void HashGridBroadphase::CountBin(const unsigned int bin)
+{
+	// sleeping bodies are keyed again too, it is cheaper than finding out which ones moved
+	for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
+	{
+		const Vec3 position = colliders.Position(id);
+		const uint64_t key = CellKey(CellCoordinate(position.x, 0), CellCoordinate(position.y, 1), CellCoordinate(position.z, 2));
+		sortEntries[id] = RadixSorter::Entry{ key, id };
+	}
+}
+
+void HashGridBroadphase::PrefixSum()
+{
+	// bodies in a cell stay in id order, so cells hold the same bodies in the same order whatever the thread count
+	sorter.Sort(pool, sortEntries, keyBits[0] + keyBits[1] + keyBits[2]);
+}
+
+void HashGridBroadphase::ScatterBin(const unsigned int bin)
+{
+	for (unsigned int i = BinBegin(bin); i < BinEnd(bin); ++i)
+	{
+		members[i] = sortEntries[i].id;
+	}
+}
+
+unsigned int HashGridBroadphase::GatherRegions()
+{
+	// runs of equal keys are the occupied cells
+	cells.clear();
+	for (unsigned int first = 0; first < bodyCount;)
+	{
+		const uint64_t key = sortEntries[first].key;
+		unsigned int end = first + 1;
+		while (end < bodyCount && sortEntries[end].key == key)
+		{
+			++end;
+		}
+		cells.push_back(Cell{ key, first, end - first });
+		first = end;
+	}
+	return RegionCount();
+}
+
+void HashGridBroadphase::FindRegionPairs(const unsigned int cellIndex, std::vector<CollisionPair>& pairs) const
+{
+	const Cell& cell = cells[cellIndex];
+	const unsigned int x = static_cast<unsigned int>(cell.key & ((uint64_t(1) << keyBits[0]) - 1));
+	const unsigned int y = static_cast<unsigned int>((cell.key >> keyBits[0]) & ((uint64_t(1) << keyBits[1]) - 1));
+	const unsigned int z = static_cast<unsigned int>(cell.key >> (keyBits[0] + keyBits[1]));
+	const unsigned int firstX = x > 0 ? x - 1 : 0;
+	const unsigned int lastX = std::min(x + 1, dimensions[0] - 1);
+
+	// the 13 neighbours with larger keys: the next cell along x, the row after in y, and the 3 rows of the next z slice
+	thread_local std::vector<PairSweep::Range> others;
+	others.clear();
+	AddRow(x + 1, lastX, y, z, cellIndex, others);
+	if (y + 1 < dimensions[1])
+	{
+		AddRow(firstX, lastX, y + 1, z, cellIndex, others);
+	}
+	if (z + 1 < dimensions[2])
+	{
+		for (unsigned int row = y > 0 ? y - 1 : 0; row <= std::min(y + 1, dimensions[1] - 1); ++row)
+		{
+			AddRow(firstX, lastX, row, z + 1, cellIndex, others);
+		}
+	}
+
+	PairSweep::Sweep(colliders, members.data(), PairSweep::Range{ cell.first, cell.count }, others, pairs);
+}
+
+void HashGridBroadphase::AddRow(const unsigned int firstX, const unsigned int lastX, const unsigned int y, const unsigned int z,
+	const unsigned int from, std::vector<PairSweep::Range>& others) const
+{
+	if (firstX > lastX) return;
+
+	// x is the lowest part of a key, so a row's cells are next to each other in key order
+	const uint64_t firstKey = CellKey(firstX, y, z);
+	const uint64_t lastKey = CellKey(lastX, y, z);
+	std::vector<Cell>::const_iterator it = std::lower_bound(cells.begin() + from + 1, cells.end(), firstKey,
+		[](const Cell& cell, const uint64_t key) { return cell.key < key; });
+	for (; it != cells.end() && it->key <= lastKey; ++it)
+	{
+		others.push_back(PairSweep::Range{ it->first, it->count });
+	}
+}
+
+void HashGridBroadphase::QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const
+{
+	if (cells.empty()) return;
+
+	// no body is more than a cell wide, so one overlapping bounds is centred at most half a cell outside of them
+	const float margin = cellSize * 0.5f;
+	const unsigned int firstX = CellCoordinate(bounds.minX - margin, 0);
+	const unsigned int lastX = CellCoordinate(bounds.maxX + margin, 0);
+	const unsigned int count = colliders.Count();
+	for (unsigned int z = CellCoordinate(bounds.minZ - margin, 2); z <= CellCoordinate(bounds.maxZ + margin, 2); ++z)
+	{
+		for (unsigned int y = CellCoordinate(bounds.minY - margin, 1); y <= CellCoordinate(bounds.maxY + margin, 1); ++y)
+		{
+			const uint64_t lastKey = CellKey(lastX, y, z);
+			std::vector<Cell>::const_iterator it = std::lower_bound(cells.begin(), cells.end(), CellKey(firstX, y, z),
+				[](const Cell& cell, const uint64_t key) { return cell.key < key; });
+			for (; it != cells.end() && it->key <= lastKey; ++it)
+			{
+				for (unsigned int i = it->first; i < it->first + it->count; ++i)
+				{
+					const unsigned int id = members[i];
+					if (id < count && PhysicsKernels::Bounds::FromStore(colliders, id).Overlaps(bounds))
+					{
+						ids.push_back(id);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "Broadphase.h"
+#include "PairSweep.h"
+#include "RadixSort.h"
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Uniform grid broadphase for scenes of similarly sized bodies. Cells are as wide as the largest body, so a body
+/// binned by its centre can only touch bodies in its own cell or the 26 around it. Bodies are radix sorted by the
+/// key of their cell, and each cell is only paired with the 13 neighbours that come after it in key order, so every
+/// pair of neighbouring cells is tested once
+/// </summary>
+class HashGridBroadphase : public Broadphase
+{
+public:
+	/// <summary>
+	/// The grid covers the box from minimum to maximum, bodies outside of it are binned into the nearest cell
+	/// </summary>
+	HashGridBroadphase(ThreadPool& pool, ColliderStore& colliders, const Vec3 minimum, const Vec3 maximum);
+
+	/// <summary>
+	/// Sizes the bins for the bodies in the store. The cells are sized again whenever bodies have been added or removed
+	/// </summary>
+	void BeginBuild() override;
+
+	/// <summary>
+	/// Finds the cell of each body in the bin
+	/// </summary>
+	void CountBin(const unsigned int bin) override;
+
+	/// <summary>
+	/// Sorts the bodies by cell
+	/// </summary>
+	void PrefixSum() override;
+
+	/// <summary>
+	/// Copies the bin's share of the sorted bodies into the member list
+	/// </summary>
+	void ScatterBin(const unsigned int bin) override;
+
+	/// <summary>
+	/// Collects the cells holding bodies this frame, the regions pairs are found in
+	/// </summary>
+	/// <returns>number of occupied cells</returns>
+	unsigned int GatherRegions() override;
+	inline unsigned int RegionCount() const override { return static_cast<unsigned int>(cells.size()); }
+
+	/// <summary>
+	/// Emits the candidate pairs of one occupied cell, with itself and its forward neighbours
+	/// </summary>
+	void FindRegionPairs(const unsigned int cellIndex, std::vector<CollisionPair>& pairs) const override;
+
+	/// <summary>
+	/// Searches the occupied cells a body overlapping bounds could be centred in
+	/// </summary>
+	void QueryBounds(const PhysicsKernels::Bounds& bounds, std::vector<unsigned int>& ids) const override;
+
+	inline const char* Name() const override { return "uniform grid"; }
+
+	inline float CellSize() const { return cellSize; }
+
+private:
+	const Vec3 minimum;
+	const Vec3 maximum;
+
+	// cells along each axis, and the bits of a cell key holding each coordinate, x lowest then y then z
+	float cellSize = 0.0f;
+	unsigned int dimensions[3] = { 1, 1, 1 };
+	unsigned int keyBits[3] = { 0, 0, 0 };
+	unsigned int sizedCount = ~0u; // body count the cells were last sized for
+
+	struct Cell
+	{
+		uint64_t key;
+		unsigned int first; // range of the member list
+		unsigned int count;
+	};
+
+	RadixSorter sorter;
+	std::vector<RadixSorter::Entry> sortEntries; // cell key and id of every body
+	std::vector<unsigned int> members; // body ids grouped by cell, in key order
+	std::vector<Cell> cells; // cells holding bodies this frame in key order
+
+	void SizeCells();
+	uint64_t CellKey(const unsigned int x, const unsigned int y, const unsigned int z) const;
+	unsigned int CellCoordinate(const float position, const int axis) const;
+
+	/// <summary>
+	/// Adds the occupied cells from firstX to lastX of one row, searching only the cells after from
+	/// </summary>
+	void AddRow(const unsigned int firstX, const unsigned int lastX, const unsigned int y, const unsigned int z,
+		const unsigned int from, std::vector<PairSweep::Range>& others) const;
+};
@@ -0,0 +1,130 @@
+#include "Islands.h"
+#include "ColliderStore.h"
+#include "globals.h"
+#include <algorithm>
+
+constexpr unsigned int Islands::noIsland;
+
+void Islands::Build(const ColliderStore& colliders, const std::vector<CollisionPair>& contacts)
+{
+	const unsigned int count = colliders.Count();
+	parent.resize(count);
+	for (unsigned int id = 0; id < count; ++id)
+	{
+		if (!colliders.asleep[id])
+		{
+			parent[id] = id;
+		}
+	}
+
+	for (const CollisionPair& contact : contacts)
+	{
+		const unsigned int rootA = Find(contact.a);
+		const unsigned int rootB = Find(contact.b);
+		if (rootA != rootB)
+		{
+			// lower id as the root so islands don't depend on the contact order
+			parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+		}
+	}
+
+	// an island is kept if any of its bodies is awake, numbered in order of its lowest awake body
+	islandIndex.assign(count, noIsland);
+	bodyIslands.resize(count);
+	bodyOffsets.assign(1, 0);
+	for (unsigned int id = 0; id < count; ++id)
+	{
+		unsigned int& island = islandIndex[Find(id)];
+		if (island == noIsland && !colliders.asleep[id])
+		{
+			island = static_cast<unsigned int>(bodyOffsets.size()) - 1;
+			bodyOffsets.push_back(0);
+		}
+	}
+
+	// counting sort the bodies and contacts by island, keeping their order within each one
+	const unsigned int islandCount = Count();
+	contactOffsets.assign(islandCount + 1, 0);
+	for (unsigned int id = 0; id < count; ++id)
+	{
+		// a sleeping body may come before the first awake body of its island, so look again
+		bodyIslands[id] = islandIndex[Find(id)];
+		if (bodyIslands[id] != noIsland)
+		{
+			++bodyOffsets[bodyIslands[id] + 1];
+		}
+	}
+	for (const CollisionPair& contact : contacts)
+	{
+		++contactOffsets[bodyIslands[contact.a] + 1];
+	}
+	for (unsigned int island = 0; island < islandCount; ++island)
+	{
+		bodyOffsets[island + 1] += bodyOffsets[island];
+		contactOffsets[island + 1] += contactOffsets[island];
+	}
+
+	bodies.resize(bodyOffsets.back());
+	islandContacts.resize(contacts.size());
+	bodyCursors.assign(bodyOffsets.begin(), bodyOffsets.end() - 1);
+	contactCursors.assign(contactOffsets.begin(), contactOffsets.end() - 1);
+	for (unsigned int id = 0; id < count; ++id)
+	{
+		if (bodyIslands[id] != noIsland)
+		{
+			bodies[bodyCursors[bodyIslands[id]]++] = id;
+		}
+	}
+	for (const CollisionPair& contact : contacts)
+	{
+		islandContacts[contactCursors[bodyIslands[contact.a]]++] = contact;
+	}
+}
+
+void Islands::UpdateSleep(ColliderStore& colliders, const unsigned int island, const float deltaTime) const
+{
+	const unsigned int* islandBodies = Bodies(island);
+	const unsigned int bodyCount = BodyCount(island);
+	const float sleepVelocitySquared = sleepVelocity * sleepVelocity;
+
+	float islandRestTime = timeToSleep;
+	for (unsigned int i = 0; i < bodyCount; ++i)
+	{
+		const unsigned int id = islandBodies[i];
+		const float speedSquared =
+			colliders.velocityX[id] * colliders.velocityX[id] +
+			colliders.velocityY[id] * colliders.velocityY[id] +
+			colliders.velocityZ[id] * colliders.velocityZ[id];
+		colliders.restTime[id] = speedSquared < sleepVelocitySquared ? std::min(colliders.restTime[id] + deltaTime, timeToSleep) : 0.0f;
+		islandRestTime = std::min(islandRestTime, colliders.restTime[id]);
+	}
+
+	// the whole island sleeps or wakes together
+	const bool sleep = islandRestTime >= timeToSleep;
+	for (unsigned int i = 0; i < bodyCount; ++i)
+	{
+		const unsigned int id = islandBodies[i];
+		if (sleep)
+		{
+			colliders.asleep[id] = 1;
+			colliders.velocityX[id] = colliders.velocityY[id] = colliders.velocityZ[id] = 0.0f;
+		}
+		else
+		{
+			// keeps its rest time, so a resting pile nudged by a settling body goes back to sleep
+			// with it rather than waking its neighbours in turn. Its links are dropped by the next Build
+			colliders.asleep[id] = 0;
+		}
+	}
+}
+
+unsigned int Islands::Find(unsigned int id)
+{
+	// path halving, every other node on the way up is pointed at its grandparent
+	while (parent[id] != id)
+	{
+		parent[id] = parent[parent[id]];
+		id = parent[id];
+	}
+	return id;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "NarrowPhase.h"
+#include <vector>
+
+class ColliderStore;
+
+/// <summary>
+/// Groups bodies joined by contacts into islands with a union find. No contact crosses two islands,
+/// so each one can be solved and put to sleep on its own without locks. Links between sleeping
+/// bodies are kept from frame to frame, so a contact with any body of a sleeping island reaches
+/// the whole island even though sleeping bodies no longer make contacts with each other
+/// </summary>
+class Islands
+{
+public:
+	Islands() : bodyOffsets(1, 0), contactOffsets(1, 0) {}
+
+	/// <summary>
+	/// Makes every awake body its own island, joins the bodies of every contact, then groups the bodies
+	/// and contacts of each island. Islands that are entirely asleep are left out, as nothing can change them
+	/// </summary>
+	void Build(const ColliderStore& colliders, const std::vector<CollisionPair>& contacts);
+
+	inline unsigned int Count() const { return static_cast<unsigned int>(bodyOffsets.size()) - 1; }
+
+	inline unsigned int BodyCount(const unsigned int island) const { return bodyOffsets[island + 1] - bodyOffsets[island]; }
+	inline const unsigned int* Bodies(const unsigned int island) const { return bodies.data() + bodyOffsets[island]; }
+
+	// contacts of an island in the order they were given to Build
+	inline unsigned int ContactCount(const unsigned int island) const { return contactOffsets[island + 1] - contactOffsets[island]; }
+	inline const CollisionPair* Contacts(const unsigned int island) const { return islandContacts.data() + contactOffsets[island]; }
+
+	/// <summary>
+	/// Updates the rest time of each of the island's bodies, then puts it to sleep if they have all
+	/// rested for timeToSleep, or wakes any of them that are asleep if not. Islands can be updated in parallel
+	/// </summary>
+	void UpdateSleep(ColliderStore& colliders, const unsigned int island, const float deltaTime) const;
+
+	/// <summary>
+	/// Root body of the island holding id, ids in the same island share a root
+	/// </summary>
+	unsigned int Find(unsigned int id);
+
+private:
+	static constexpr unsigned int noIsland = ~0u;
+
+	std::vector<unsigned int> parent;
+	std::vector<unsigned int> islandIndex; // island of each root body, noIsland if it is entirely asleep
+	std::vector<unsigned int> bodyIslands; // island of each body
+
+	// island i is [offsets[i], offsets[i + 1]) of each list
+	std::vector<unsigned int> bodyOffsets;
+	std::vector<unsigned int> bodies;
+	std::vector<unsigned int> contactOffsets;
+	std::vector<CollisionPair> islandContacts;
+	std::vector<unsigned int> bodyCursors; // where the next body and contact of each island go while grouping
+	std::vector<unsigned int> contactCursors;
+};
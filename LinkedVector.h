@@ -100,6 +100,11 @@ public:
 		next = pNext;
 	}
 
+	inline LinkedVector* Next() noexcept
+	{
+		return next;
+	}
+
 	inline T& operator[](const unsigned int _Pos) noexcept
 	{
 		return vector[_Pos];
@@ -1,6 +1,7 @@
 #ifdef _DEBUG
 #include <iostream>
 #include <exception>
+#include <mutex>
 #include "MemoryManager.h"
 #include "Tracker.h"
 
@@ -22,6 +23,10 @@ namespace MemoryManager
 
 		Header* startHeader = nullptr; // where to begin walking the heap from
 		Header* endHeader = nullptr; // to add new headers to the end
+
+		// guards the header list and trackers, as any thread can allocate. Walking the heap doesn't take it,
+		// printing could allocate and deadlock, so walks are only reliable while other threads are idle
+		std::mutex heapMutex;
 	} // END VARIABLES
 
 	char InitTrackers()
@@ -140,6 +145,7 @@ namespace MemoryManager
 
 	void* UpdateTrackerDeallocation(void* ptr)
 	{
+		std::lock_guard<std::mutex> guard(heapMutex);
 		ptr = (char*)ptr - sizeof(Header);
 
 		Header* header = (Header*)ptr;
@@ -171,6 +177,7 @@ namespace MemoryManager
 	void* UpdateTrackerAllocation(void* ptr, const size_t size, const TrackerIndex tracker)
 	{
 		static char initialised = InitTrackers(); // use of static variable initialisation to only init the trackers once
+		std::lock_guard<std::mutex> guard(heapMutex);
 
 		Header* headerPtr = (Header*)ptr;
 
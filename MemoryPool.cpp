@@ -159,50 +159,76 @@ namespace MemoryPoolManager
 
 	StaticMemoryPool::StaticMemoryPool(const size_t chunkSize, const size_t chunkCount) :
 		chunkSize(chunkSize),
-		chunkCount(chunkCount)
+		chunkCount(chunkCount),
+		blocks(nullptr),
+		blockCount(0),
+		capacity(0),
+		freeList(nullptr),
+		freeChunkCount(0)
 	{
-		start = (Byte*)std::malloc(chunkSize * chunkCount);
-		freeList = (void**)std::malloc(sizeof(void*) * chunkCount);
-		freeChunkCount = 0;
-		if (freeList != nullptr && start != nullptr)
-		{
-			for (size_t i = 0; i < chunkCount; ++i)
-			{
-				freeList[i] = start + (i * chunkSize);
-			}
-			freeChunkCount = chunkCount;
-
-			end = start + (chunkSize * chunkCount);
-		}
+		Grow(chunkCount);
 	}
 
 	StaticMemoryPool::~StaticMemoryPool()
 	{
-		std::free(start);
+		for (size_t i = 0; i < blockCount; ++i)
+		{
+			std::free(blocks[i].start);
+		}
+		std::free(blocks);
 		std::free(freeList);
 	}
 
+	bool StaticMemoryPool::Grow(const size_t chunks)
+	{
+		// uses malloc rather than new, as new would come back to the pools.
+		// Every chunk could be free at once, so the free list grows to hold all of them
+		if (chunks == 0) return false;
+		Byte* start = (Byte*)std::malloc(chunkSize * chunks);
+		Block* grownBlocks = (Block*)std::realloc(blocks, sizeof(Block) * (blockCount + 1));
+		if (grownBlocks != nullptr) blocks = grownBlocks;
+		void** grownFreeList = (void**)std::realloc(freeList, sizeof(void*) * (capacity + chunks));
+		if (grownFreeList != nullptr) freeList = grownFreeList;
+		if (start == nullptr || grownBlocks == nullptr || grownFreeList == nullptr)
+		{
+			std::free(start);
+			return false;
+		}
+
+		blocks[blockCount++] = Block{ start, start + (chunkSize * chunks) };
+		capacity += chunks;
+		for (size_t i = 0; i < chunks; ++i)
+		{
+			freeList[freeChunkCount++] = start + (i * chunkSize);
+		}
+		return true;
+	}
+
 	void* StaticMemoryPool::Allocate()
 	{
-		if(freeChunkCount == 0) return nullptr;
+		if (freeChunkCount == 0 && !Grow(capacity != 0 ? capacity : chunkCount)) return nullptr;
 
 		return freeList[--freeChunkCount];
 	}
 
 	bool StaticMemoryPool::Free(void* ptr)
 	{
-		if (start <= ptr && ptr <= end)
+		for (size_t i = 0; i < blockCount; ++i)
 		{
-			freeList[freeChunkCount++] = ptr;
-			return true;
+			if (blocks[i].start <= ptr && ptr < blocks[i].end)
+			{
+				freeList[freeChunkCount++] = ptr;
+				return true;
+			}
 		}
 		return false;
 	}
 
 	void StaticMemoryPool::Print()
 	{
-		std::cout << "\nPrinting static pool with chunk size: " << chunkSize << ", and chunk count of: " << chunkCount << std::endl;
-		std::cout << "Pointer to start of first chunk: " << (void*)start << std::endl;
+		std::cout << "\nPrinting static pool with chunk size: " << chunkSize << ", and chunk count of: " << capacity
+			<< " in " << blockCount << " blocks, starting with " << chunkCount << std::endl;
+		std::cout << "Pointer to start of first chunk: " << (void*)(blockCount != 0 ? blocks[0].start : nullptr) << std::endl;
 		std::cout << "Free chunks = " << freeChunkCount << std::endl;
 	}
 }
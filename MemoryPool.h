@@ -28,6 +28,10 @@ namespace MemoryPoolManager
 		static constexpr Byte combinedMask = 0b11000000;
 	};
 
+	/// <summary>
+	/// Pool of fixed size chunks. Starts with chunkCount chunks and doubles whenever it runs out, so the
+	/// starting count only needs to be a good guess rather than an upper bound
+	/// </summary>
 	class StaticMemoryPool
 	{
 
@@ -42,12 +46,22 @@ namespace MemoryPoolManager
 		void Print();
 
 	private:
+		// a run of chunks malloced at once, the first holds the starting chunkCount and each one after as many as all before it
+		struct Block
+		{
+			Byte* start;
+			Byte* end;
+		};
+
 		const size_t chunkSize;
 		const size_t chunkCount;
 
-		Byte* start;
-		Byte* end;
+		Block* blocks;
+		size_t blockCount;
+		size_t capacity; // chunks in every block together
 		void** freeList;
-		unsigned int freeChunkCount;
+		size_t freeChunkCount;
+
+		bool Grow(const size_t chunks);
 	};
 }
\ No newline at end of file
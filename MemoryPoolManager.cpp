@@ -3,11 +3,12 @@
 #include "MemoryManager.h"
 #include "globals.h"
 #include <cstdlib>
-#include "ColliderObject.h"
 #include "Octree.h"
+#include "DynamicAabbTree.h"
 #include <new> // placement new
 #include <map>
-#include <queue>
+#include <mutex>
+#include <algorithm>
 
 
 namespace MemoryPoolManager
@@ -16,24 +17,25 @@ namespace MemoryPoolManager
 	{
 		MemoryPool* poolPtr = nullptr;
 
-		constexpr size_t staticPoolCount = 3;
-		constexpr size_t octantQueueBlockSize = std::queue<Octree::Octant*>::container_type::_EEN_DS;
+		constexpr size_t staticPoolCount = 2;
 
 #ifdef _DEBUG
 		constexpr size_t staticPoolSizes[staticPoolCount] = {
-			sizeof(ColliderObject) + sizeof(MemoryManager::Header) + sizeof(MemoryManager::Footer),
 			sizeof(Octree::Octant) + sizeof(MemoryManager::Header) + sizeof(MemoryManager::Footer),
-			(octantQueueBlockSize * sizeof(Octree::Octant*)) + sizeof(MemoryManager::Header) + sizeof(MemoryManager::Footer)
+			sizeof(DynamicAabbTree::Node) + sizeof(MemoryManager::Header) + sizeof(MemoryManager::Footer)
 		};
 #else
 		constexpr size_t staticPoolSizes[staticPoolCount] = {
-			sizeof(ColliderObject),
 			sizeof(Octree::Octant),
-			octantQueueBlockSize * sizeof(Octree::Octant*)
+			sizeof(DynamicAabbTree::Node)
 		};
 #endif // _DEBUG
 
 		std::array<StaticMemoryPool*, staticPoolCount> staticPools;
+
+		// the render, physics and worker threads all allocate, and no pool is safe to change from two at once.
+		// std::mutex is constant initialised, so it is ready before anything is allocated during static init
+		std::mutex poolMutex;
 	}
 
 	char InitMemoryPools()
@@ -54,14 +56,37 @@ namespace MemoryPoolManager
 			InitMemoryPools();
 		}
 
-		// amount of chunks to allocate for static memory pools
-		unsigned int chunkCounts[staticPoolCount] = {
-			boxCount + sphereCount,
-
+		// amount of chunks to start the static memory pools with, they double whenever they run out. The broadphase
+		// can be switched while running, so there is room for the octree and the aabb tree whichever one starts
+		unsigned int chunkCounts[staticPoolCount] = { 0 };
+		if (octreeLayout == OctreeLayout::Linear)
+		{
+			// a linear octree only has its root
+			chunkCounts[0] = 1;
+		}
+		else if (octreeLayout == OctreeLayout::Sparse)
+		{
+			// a sparse octree only has the octants on each body's way down from the root and those left empty by
+			// moving bodies and not removed yet. Bodies share most of their paths, so there are usually fewer octants
+			// than bodies. The full tree could be far too big to count, the pool grows past this if it has to
+			chunkCounts[0] = boxCount + sphereCount + 1;
+		}
+		else
+		{
 			// Equation for number of octants taken from wolfram, (1 << 3 * ... ) is compile time power of 8
-			(1.0 / 7.0) * (-1 + (1 << (3 * (1 + octreeDepth)))),
-			((1.0 / 7.0) * (-1 + (1 << (3 * (1 + octreeDepth)))) / octantQueueBlockSize) + 3
-		};
+			chunkCounts[0] = (1.0 / 7.0) * (-1 + (1 << (3 * (1 + octreeDepth))));
+
+			// an adaptive octree only splits where bodies are, so usually has about one split octant per mergeCount
+			// bodies on each level. Octants waiting out mergeDelay can take it past that, the pool grows to fit
+			if (octreeLayout == OctreeLayout::Adaptive)
+			{
+				const unsigned int adaptiveOctants = 8 * octreeDepth * ((boxCount + sphereCount) / Octree::mergeCount + 1) + 1;
+				chunkCounts[0] = std::min(chunkCounts[0], adaptiveOctants);
+			}
+		}
+
+		// an aabb tree has a leaf per body and one fewer nodes above them, with room for as many bodies again to be added
+		chunkCounts[1] = 4 * (boxCount + sphereCount) + 1;
 
 		// create static pools
 		char* staticPoolBegin = (char*)poolPtr + sizeof(MemoryPool);
@@ -74,6 +99,7 @@ namespace MemoryPoolManager
 	void* RequestMemory(size_t size)
 	{
 		static char initialised = InitMemoryPools();
+		std::lock_guard<std::mutex> guard(poolMutex);
 
 		// if should be fit into static pool try and place it in there
 		for (size_t i = 0; i < staticPoolCount; ++i)
@@ -94,9 +120,10 @@ namespace MemoryPoolManager
 	{
 		if (!poolPtr) return true;
 
+		std::lock_guard<std::mutex> guard(poolMutex);
 		for (size_t i = 0; i < staticPoolCount; ++i)
 		{
-			if (staticPools[i]->Free(ptr))
+			if (staticPools[i] != nullptr && staticPools[i]->Free(ptr))
 			{
 				return true;
 			}
@@ -0,0 +1,60 @@
+#include "NarrowPhase.h"
+#include "ColliderStore.h"
+#include "PhysicsKernels.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace NarrowPhase
+{
+	void SortPairs(std::vector<CollisionPair>& pairs)
+	{
+		// sorting packed 64 bit keys is much quicker than comparing pairs member by member
+		thread_local std::vector<uint64_t> keys;
+		keys.resize(pairs.size());
+		for (size_t i = 0; i < pairs.size(); ++i)
+		{
+			const unsigned int low = std::min(pairs[i].a, pairs[i].b);
+			const unsigned int high = std::max(pairs[i].a, pairs[i].b);
+			keys[i] = (static_cast<uint64_t>(low) << 32) | high;
+		}
+
+		std::sort(keys.begin(), keys.end());
+
+		for (size_t i = 0; i < pairs.size(); ++i)
+		{
+			pairs[i] = CollisionPair{ static_cast<unsigned int>(keys[i] >> 32), static_cast<unsigned int>(keys[i]) };
+		}
+	}
+
+	void Filter(const ColliderStore& colliders, const std::vector<CollisionPair>& candidates, std::vector<CollisionPair>& contacts)
+	{
+		thread_local PhysicsKernels::PackedBounds packed;
+
+		const size_t candidateCount = candidates.size();
+		for (size_t runStart = 0, runEnd = 0; runStart < candidateCount; runStart = runEnd)
+		{
+			// find the run of pairs with the same first body
+			const unsigned int a = candidates[runStart].a;
+			for (runEnd = runStart + 1; runEnd < candidateCount && candidates[runEnd].a == a; ++runEnd);
+
+			packed.Clear();
+			for (size_t i = runStart; i < runEnd; ++i)
+			{
+				packed.Add(colliders, candidates[i].b);
+			}
+			packed.Pad();
+
+			for (unsigned int first = 0; first < packed.Count(); first += PhysicsKernels::overlapBatch)
+			{
+				unsigned int hits = PhysicsKernels::OverlapMask(colliders, a, packed, first);
+				for (unsigned int i = first; hits != 0; ++i, hits >>= 1)
+				{
+					if (hits & 1)
+					{
+						contacts.push_back(CollisionPair{ a, packed.ids[i] });
+					}
+				}
+			}
+		}
+	}
+}
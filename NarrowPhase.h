@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+
+class ColliderStore;
+
+/// <summary>
+/// Two bodies that may be colliding, emitted by the broadphase
+/// </summary>
+struct CollisionPair
+{
+	unsigned int a;
+	unsigned int b;
+};
+
+/// <summary>
+/// Second half of collision detection, works on the candidate pairs the broadphase emits
+/// </summary>
+namespace NarrowPhase
+{
+	/// <summary>
+	/// Puts pairs in a canonical order independent of how the broadphase emitted them, each pair
+	/// has its lower id first and pairs are sorted by first then second id
+	/// </summary>
+	void SortPairs(std::vector<CollisionPair>& pairs);
+
+	/// <summary>
+	/// Appends the candidate pairs whose bounds overlap to contacts. Consecutive pairs sharing the same
+	/// first body are tested together with the batched overlap kernel, so the broadphase
+	/// should emit pairs grouped that way
+	/// </summary>
+	void Filter(const ColliderStore& colliders, const std::vector<CollisionPair>& candidates, std::vector<CollisionPair>& contacts);
+}
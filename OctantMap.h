@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Open addressing hash map from an octant's locational code to its index in the octree. A locational code
+/// is a 1 followed by the octant's child index at each level from the root down, three bits a level, so the
+/// root is 1 and every code is unique and non zero. Collisions are resolved by probing the next slots in turn
+/// </summary>
+class OctantMap
+{
+public:
+	static constexpr unsigned int noOctant = ~0u;
+
+	OctantMap() : count(0)
+	{
+		slots.resize(minCapacity, Slot{ 0, noOctant });
+	}
+
+	/// <summary>
+	/// Index of the octant with the given code, noOctant if there is none. Safe to call from many threads
+	/// as long as nothing is inserted or erased at the same time
+	/// </summary>
+	inline unsigned int Find(const uint64_t key) const
+	{
+		const size_t mask = slots.size() - 1;
+		for (size_t slot = Hash(key) & mask; ; slot = (slot + 1) & mask)
+		{
+			if (slots[slot].key == key) return slots[slot].index;
+			if (slots[slot].key == 0) return noOctant;
+		}
+	}
+
+	/// <summary>
+	/// Adds an octant, its code must not already be in the map
+	/// </summary>
+	void Insert(const uint64_t key, const unsigned int index)
+	{
+		// keep at most half of the slots full so probes stay short
+		if ((count + 1) * 2 > slots.size())
+		{
+			Grow(slots.size() * 2);
+		}
+
+		const size_t mask = slots.size() - 1;
+		size_t slot = Hash(key) & mask;
+		while (slots[slot].key != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = Slot{ key, index };
+		++count;
+	}
+
+	/// <summary>
+	/// Removes an octant, shifting back any later entries of the probe run so no tombstones are left behind
+	/// </summary>
+	void Erase(const uint64_t key)
+	{
+		const size_t mask = slots.size() - 1;
+		size_t hole = Hash(key) & mask;
+		while (slots[hole].key != key)
+		{
+			if (slots[hole].key == 0) return;
+			hole = (hole + 1) & mask;
+		}
+
+		for (size_t slot = (hole + 1) & mask; slots[slot].key != 0; slot = (slot + 1) & mask)
+		{
+			// an entry can fill the hole if the hole lies between its home slot and where it is now
+			const size_t home = Hash(slots[slot].key) & mask;
+			if (((slot - home) & mask) >= ((slot - hole) & mask))
+			{
+				slots[hole] = slots[slot];
+				hole = slot;
+			}
+		}
+		slots[hole] = Slot{ 0, noOctant };
+		--count;
+	}
+
+	inline size_t Count() const { return count; }
+
+	/// <summary>
+	/// Makes room for at least entries octants, so inserting up to that many never has to grow the map
+	/// </summary>
+	void Reserve(const size_t entries)
+	{
+		size_t capacity = slots.size();
+		while (entries * 2 > capacity)
+		{
+			capacity *= 2;
+		}
+		if (capacity != slots.size())
+		{
+			Grow(capacity);
+		}
+	}
+
+private:
+	static constexpr size_t minCapacity = 64; // must be a power of 2
+
+	struct Slot
+	{
+		uint64_t key; // 0 if the slot is empty
+		unsigned int index;
+	};
+
+	std::vector<Slot> slots;
+	size_t count;
+
+	static inline size_t Hash(const uint64_t key)
+	{
+		// codes of nearby octants only differ in their low bits, multiplying spreads them over the whole word
+		return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	void Grow(const size_t capacity)
+	{
+		std::vector<Slot> old(capacity, Slot{ 0, noOctant });
+		old.swap(slots);
+		count = 0;
+		for (const Slot& slot : old)
+		{
+			if (slot.key != 0)
+			{
+				Insert(slot.key, slot.index);
+			}
+		}
+	}
+};
@@ -1,38 +1,27 @@
 #include "Octree.h"
 #include "ColliderObject.h"
+#include "ColliderStore.h"
+#include "PhysicsKernels.h"
+#include <algorithm>
 #include <cmath>
-#include <thread>
 #include <iostream>
 #include "MemoryOperators.h"
 #include "TrackerIndex.h"
 
-void Octree::ThreadLoop()
+constexpr unsigned int Octree::noParent;
+
+namespace
 {
-	while (!shouldTerminate)
+	PhysicsKernels::Bounds LooseBounds(const Vec3& centre, const Vec3& halfExtent, const float looseness)
 	{
-		std::unique_lock<std::mutex> lock(queueMutex);
-
-		queueUpdateCondition.wait(lock, [this]() {
-			return !octantQueue.empty() || shouldTerminate;
-			});
-
-		if (!octantQueue.empty())
-		{
-			++busyThreads;
-			Octant* task = octantQueue.front();
-			octantQueue.pop();
-
-			lock.unlock();
-			task->TestCollisions();
-			lock.lock();
-
-			--busyThreads;
-			collisionsTested.notify_one();
-		}
+		return PhysicsKernels::Bounds{
+			centre.x - halfExtent.x * looseness, centre.y - halfExtent.y * looseness, centre.z - halfExtent.z * looseness,
+			centre.x + halfExtent.x * looseness, centre.y + halfExtent.y * looseness, centre.z + halfExtent.z * looseness
+		};
 	}
 }
 
-void Octree::InsertObject(Octant* pOctant, ColliderObject* pObj)
+Octree::Octant* Octree::FindOctant(Octant* pOctant, const Vec3& position, const Vec3& size) const
 {
 	unsigned int index = 0;
 	bool straddle = false;
@@ -43,8 +32,8 @@ void Octree::InsertObject(Octant* pOctant, ColliderObject* pObj)
 		// if the distance to the axis split is smaller than the
 		// half size of the object, then the object straddles that
 		// splitting axis, so stop checking other axes
-		float delta = pObj->position[i] - pOctant->centre[i];
-		if (abs(delta) <= pObj->size[i] / 2) 
+		float delta = position[i] - pOctant->centre[i];
+		if (abs(delta) <= size[i] / 2) 
 		{
 			straddle = true;
 			break;
@@ -52,52 +41,234 @@ void Octree::InsertObject(Octant* pOctant, ColliderObject* pObj)
 		if (delta > 0.0f) index |= (1 << i); // the side the object is on affects index
 	}
 
-	// if not straddling and child exists insert deeper
+	// if not straddling and child exists go deeper
 	if (!straddle && pOctant->children[index])
 	{
-		InsertObject(pOctant->children[index], pObj);
+		return FindOctant(pOctant->children[index], position, size);
+	}
+
+	// if there is no more children or the object is
+	// straddling an axis, it belongs in the current octant
+	return pOctant;
+}
+
+Octree::Octant* Octree::FindLooseOctant(const Vec3& position, const Vec3& size) const
+{
+	// sink towards the child holding the body's centre, for as long as the child's loose bounds hold all of it
+	Octant* pOctant = root;
+	Vec3 halfExtent = rootHalfExtent;
+	while (pOctant->children[0] != nullptr)
+	{
+		halfExtent = halfExtent / 2.0f;
+		unsigned int index = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			if (position[i] > pOctant->centre[i]) index |= (1 << i);
+		}
+
+		Octant* pChild = pOctant->children[index];
+		for (int i = 0; i < 3; i++)
+		{
+			if (std::abs(position[i] - pChild->centre[i]) + size[i] / 2 > halfExtent[i] * looseness)
+			{
+				return pOctant;
+			}
+		}
+		pOctant = pChild;
+	}
+	return pOctant;
+}
+
+uint64_t Octree::BodyKey(const Vec3& position, const Vec3& size) const
+{
+	// cells of the deepest level, a body sticking out of the root is treated as if clipped to it,
+	// which still leaves any two overlapping bodies sharing a cell
+	const float cellsPerAxis = static_cast<float>(1u << maxDepth);
+	const bool loose = looseness > 1.0f;
+	unsigned int cellMin[3];
+	unsigned int cellMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const float rootMin = root->centre[i] - rootHalfExtent[i];
+		const float scale = cellsPerAxis / (2.0f * rootHalfExtent[i]);
+		const float low = loose ? position[i] : position[i] - size[i] / 2;
+		const float high = loose ? position[i] : position[i] + size[i] / 2;
+		cellMin[i] = static_cast<unsigned int>(std::min(std::max((low - rootMin) * scale, 0.0f), cellsPerAxis - 1.0f));
+		cellMax[i] = static_cast<unsigned int>(std::min(std::max((high - rootMin) * scale, 0.0f), cellsPerAxis - 1.0f));
+	}
+
+	unsigned int depth = maxDepth;
+	if (loose)
+	{
+		// sink by the centre's cell for as long as the octant's loose bounds hold all of the body, like FindLooseOctant
+		for (depth = 1; depth <= maxDepth; depth++)
+		{
+			const Vec3 halfExtent = rootHalfExtent / static_cast<float>(1u << depth);
+			bool fits = true;
+			for (int i = 0; i < 3; i++)
+			{
+				const unsigned int cell = cellMin[i] >> (maxDepth - depth);
+				const float centre = root->centre[i] - rootHalfExtent[i] + (2.0f * cell + 1.0f) * halfExtent[i];
+				fits = fits && std::abs(position[i] - centre) + size[i] / 2 <= halfExtent[i] * looseness;
+			}
+			if (!fits) break;
+		}
+		--depth;
 	}
 	else
 	{
-		// if there is no more children or the object is
-		// straddling an axis, add to current octants list
-		pOctant->AddToList(pObj);
+		// the deepest octant holding both corners is where the corners' cells stop sharing a prefix
+		unsigned int differ = (cellMin[0] ^ cellMax[0]) | (cellMin[1] ^ cellMax[1]) | (cellMin[2] ^ cellMax[2]);
+		while (differ != 0)
+		{
+			--depth;
+			differ >>= 1;
+		}
+	}
+
+	// interleave the cell's bits from the root down under the leading 1
+	uint64_t key = 1;
+	for (unsigned int level = 1; level <= depth; level++)
+	{
+		const unsigned int bit = maxDepth - level;
+		key = (key << 3) |
+			(((cellMin[0] >> bit) & 1) << 0) |
+			(((cellMin[1] >> bit) & 1) << 1) |
+			(((cellMin[2] >> bit) & 1) << 2);
+	}
+	return key;
+}
+
+Octree::Octant* Octree::FindOrCreate(const uint64_t key)
+{
+	const unsigned int index = octantMap.Find(key);
+	if (index != OctantMap::noOctant)
+	{
+		return octants[index];
 	}
+
+	// the root is always in the map, so this stops there at the latest
+	Octant* pParent = FindOrCreate(key >> 3);
+	return CreateChild(pParent, static_cast<unsigned int>(key & 7), rootHalfExtent / static_cast<float>(1u << (pParent->depth + 1)));
 }
 
 void Octree::BuildTree(Octant* pCurrent, const Vec3 extent, const unsigned int depth, const unsigned int maxDepth)
 {
 	Vec3 halfExtent = extent / 2.0f;
+	Split(pCurrent, halfExtent);
+
+	if (depth != maxDepth)
+	{
+		for (Octant* pChild : pCurrent->children)
+		{
+			BuildTree(pChild, halfExtent, depth + 1, maxDepth);
+		}
+	}
+}
+
+Octree::Octant* Octree::CreateChild(Octant* pParent, const unsigned int child, const Vec3 halfExtent)
+{
+	// reuse the index of a removed octant if there is one, so the lists don't grow as the tree changes
+	unsigned int index = static_cast<unsigned int>(octants.size());
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		octants.push_back(nullptr);
+		looseBounds.emplace_back();
+		octantKeys.push_back(0);
+	}
+
 	Vec3 offset;
+	offset.x = ((child & 1) ? halfExtent.x : -halfExtent.x);
+	offset.y = ((child & 2) ? halfExtent.y : -halfExtent.y);
+	offset.z = ((child & 4) ? halfExtent.z : -halfExtent.z);
+	Octant* pChild = new Octant(pParent->centre + offset, pParent, index, pParent->depth + 1);
+	pParent->children[child] = pChild;
+	octants[index] = pChild;
+	looseBounds[index] = LooseBounds(pChild->centre, halfExtent, looseness);
+	octantKeys[index] = (octantKeys[pParent->index] << 3) | child;
+	if (layout == OctreeLayout::Sparse)
+	{
+		octantMap.Insert(octantKeys[index], index);
+	}
+	return pChild;
+}
 
+void Octree::DeleteOctant(Octant* pOctant)
+{
+	octants[pOctant->index] = nullptr;
+	freeIndices.push_back(pOctant->index);
+	if (layout == OctreeLayout::Sparse)
+	{
+		octantMap.Erase(octantKeys[pOctant->index]);
+	}
+	delete pOctant;
+}
+
+void Octree::Split(Octant* pOctant, const Vec3 halfExtent)
+{
 	for (unsigned int i = 0; i < 8; i++)
 	{
-		offset.x = ((i & 1) ? halfExtent.x : -halfExtent.x);
-		offset.y = ((i & 2) ? halfExtent.y : -halfExtent.y);
-		offset.z = ((i & 4) ? halfExtent.z : -halfExtent.z);
-		pCurrent->children[i] = new Octant(pCurrent->centre + offset, pCurrent);
+		CreateChild(pOctant, i, halfExtent);
+	}
+}
+
+void Octree::Merge(Octant* pOctant)
+{
+	// only ever called on octants whose children are all leaves
+	for (Octant*& child : pOctant->children)
+	{
+		DeleteOctant(child);
+		child = nullptr;
+	}
+}
+
+void Octree::Prune()
+{
+	mergeOctants.clear();
+	for (Octant* pOctant : octants)
+	{
+		if (pOctant == nullptr || pOctant == root) continue;
 
-		if (depth != maxDepth)
+		bool leaf = true;
+		for (const Octant* pChild : pOctant->children)
 		{
-			BuildTree(pCurrent->children[i], halfExtent, depth + 1, maxDepth);
+			leaf = leaf && pChild == nullptr;
 		}
+		pOctant->quietFrames = leaf && pOctant->Count(epoch) == 0 ? pOctant->quietFrames + 1 : 0;
+		if (pOctant->quietFrames >= mergeDelay)
+		{
+			mergeOctants.push_back(pOctant);
+		}
+	}
+
+	// empty octants hold no sleeping bodies, so nothing needs binning again.
+	// Parents left without children are removed once they have been empty as long
+	for (Octant* pOctant : mergeOctants)
+	{
+		pOctant->Parent()->children[octantKeys[pOctant->index] & 7] = nullptr;
+		DeleteOctant(pOctant);
 	}
 }
 
-void Octree::TestAllCollisions(Octant* pOctant)
+void Octree::GatherActive(Octant* pOctant)
 {
+	if (pOctant->Count(epoch) != 0)
 	{
-		std::lock_guard<std::mutex> guard(queueMutex);
-		octantQueue.push(pOctant);
+		activeOctants.push_back(pOctant);
 	}
-	queueUpdateCondition.notify_one();
-	
+
+	// only descend into subtrees that hold bodies
+	const unsigned char childMask = pOctant->ChildMask(epoch);
 	for (int i = 0; i < 8; i++)
 	{
-		Octant* child = pOctant->children[i];
-		if (child != nullptr)
+		if (childMask & (1 << i))
 		{
-			TestAllCollisions(child);
+			GatherActive(pOctant->children[i]);
 		}
 	}
 }
@@ -115,150 +286,437 @@ void Octree::DeleteChildren(Octant* pOctant)
 	}
 }
 
-void Octree::ClearList(Octant* pOctant)
+Octree::Octree(ThreadPool& pool, ColliderStore& colliders, const Vec3 position, const Vec3 extent, const unsigned int maxDepth, const float looseness, const OctreeLayout layout) :
+	Broadphase(pool, colliders), looseness(layout == OctreeLayout::Linear ? 1.0f : looseness), rootHalfExtent(extent), layout(layout), maxDepth(maxDepth)
 {
-	for (Octant*& child : pOctant->children)
+	root = new Octant(position, nullptr, 0, 0);
+	octants.push_back(root);
+	looseBounds.push_back(LooseBounds(position, extent, looseness));
+	octantKeys.push_back(1);
+	if (layout == OctreeLayout::Sparse)
 	{
-		if (child != nullptr)
-		{
-			ClearList(child);
-		}
+		octantMap.Insert(1, 0);
+	}
+	if (maxDepth != 0 && layout == OctreeLayout::Full)
+	{
+		BuildTree(root, extent, 1, maxDepth);
+	}
+}
+
+Octree::~Octree()
+{
+	DeleteChildren(root);
+	delete root;
+}
 
-		pOctant->ClearList();
+void Octree::BeginBuild()
+{
+	// a new frame empties every octant, ranges from older frames are ignored
+	++epoch;
+
+	// one bin of bodies per thread, the pool's thread count can change between frames
+	SizeBins();
+	if (binHistograms.size() != binCount)
+	{
+		binHistograms.resize(binCount);
+		binOctants.resize(binCount);
+		binMissing.resize(binCount);
+	}
+	SizeHistograms();
+
+	rebinSleeping = treeChanged;
+	treeChanged = false;
+
+	bodyOctants.resize(bodyCount);
+	members.resize(bodyCount);
+	if (layout == OctreeLayout::Sparse)
+	{
+		// a sparse octree rarely has more octants than bodies, so growing the map here keeps
+		// PrefixSum and Adapt from rehashing it as they make octants
+		octantMap.Reserve(bodyCount);
+	}
+	if (layout == OctreeLayout::Linear)
+	{
+		bodySortKeys.resize(bodyCount);
+		sortEntries.resize(bodyCount);
 	}
 }
 
-Octree::Octree(const Vec3 position, const Vec3 extent, const unsigned int maxDepth)
+void Octree::CountBin(const unsigned int bin)
 {
-	root = new Octant(position, nullptr);
-	if (maxDepth != 0)
+	if (layout == OctreeLayout::Linear)
 	{
-		BuildTree(root, extent, 1, maxDepth);
+		// sleeping bodies haven't moved, so keep their key once they have one
+		for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
+		{
+			if (!colliders.asleep[id] || rebinSleeping)
+			{
+				bodySortKeys[id] = SortKey(BodyKey(colliders.Position(id), colliders.Size(id)));
+			}
+			sortEntries[id] = RadixSorter::Entry{ bodySortKeys[id], id };
+		}
+		return;
 	}
-	
-	threads.resize(threadCount);
-	for (std::thread& thread : threads)
+
+	std::vector<BinEntry>& histogram = binHistograms[bin];
+	std::vector<unsigned int>& touched = binOctants[bin];
+	touched.clear();
+
+	std::vector<MissingBody>& missing = binMissing[bin];
+	missing.clear();
+
+	const bool loose = looseness > 1.0f;
+	for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
 	{
-		thread = std::thread(&Octree::ThreadLoop, this);
+		// sleeping bodies haven't moved since they were last binned, so keep their octant unless it was merged away
+		if (layout == OctreeLayout::Sparse && (!colliders.asleep[id] || rebinSleeping))
+		{
+			// octants are looked up by code, bins can't make them so any that are missing are left to PrefixSum
+			const uint64_t key = BodyKey(colliders.Position(id), colliders.Size(id));
+			const unsigned int octant = octantMap.Find(key);
+			if (octant == OctantMap::noOctant)
+			{
+				missing.push_back(MissingBody{ id, key });
+				continue;
+			}
+			bodyOctants[id] = octant;
+		}
+		else if (!colliders.asleep[id] || rebinSleeping)
+		{
+			const Octant* pOctant = loose ?
+				FindLooseOctant(colliders.Position(id), colliders.Size(id)) :
+				FindOctant(root, colliders.Position(id), colliders.Size(id));
+			bodyOctants[id] = pOctant->index;
+		}
+		const unsigned int octant = bodyOctants[id];
+
+		// reset counts left over from an earlier frame the first time they are touched
+		BinEntry& entry = histogram[octant];
+		if (entry.epoch != epoch)
+		{
+			entry = BinEntry{ epoch, 0 };
+			touched.push_back(octant);
+		}
+		++entry.count;
 	}
 }
 
-Octree::~Octree()
+void Octree::PrefixSum()
 {
+	if (layout == OctreeLayout::Linear)
 	{
-		std::lock_guard<std::mutex> guard(queueMutex);
-		shouldTerminate = true;
+		sorter.Sort(pool, sortEntries, 3 * maxDepth + levelBits);
+		BuildLinearOctants();
+		return;
 	}
-	queueUpdateCondition.notify_all();
 
-	for (std::thread& thread : threads)
+	// make the octants bodies landed in that didn't exist yet. Bins are in id order,
+	// so new octants get the same indices whatever the thread count
+	if (layout == OctreeLayout::Sparse)
 	{
-		thread.join();
+		for (const std::vector<MissingBody>& missing : binMissing)
+		{
+			for (const MissingBody& body : missing)
+			{
+				bodyOctants[body.id] = FindOrCreate(body.key)->index;
+			}
+		}
+		SizeHistograms();
+
+		for (unsigned int bin = 0; bin < BinCount(); ++bin)
+		{
+			for (const MissingBody& body : binMissing[bin])
+			{
+				const unsigned int octant = bodyOctants[body.id];
+				BinEntry& entry = binHistograms[bin][octant];
+				if (entry.epoch != epoch)
+				{
+					entry = BinEntry{ epoch, 0 };
+					binOctants[bin].push_back(octant);
+				}
+				++entry.count;
+			}
+		}
 	}
 
-	DeleteChildren(root);
-	delete root;
+	// gather the octants any bin touched, so the prefix sum only visits octants with bodies
+	usedOctants.clear();
+	for (const std::vector<unsigned int>& touched : binOctants)
+	{
+		for (const unsigned int octant : touched)
+		{
+			Octant* pOctant = octants[octant];
+			if (pOctant->epoch != epoch)
+			{
+				pOctant->epoch = epoch;
+				pOctant->MarkOccupied(epoch);
+				usedOctants.push_back(pOctant);
+			}
+		}
+	}
+
+	// prefix sum over octants then bins turns the counts into where each bin writes its bodies
+	unsigned int offset = 0;
+	for (Octant* pOctant : usedOctants)
+	{
+		pOctant->first = offset;
+		for (std::vector<BinEntry>& histogram : binHistograms)
+		{
+			BinEntry& entry = histogram[pOctant->index];
+			if (entry.epoch != epoch) continue;
+
+			const unsigned int count = entry.count;
+			entry.count = offset;
+			offset += count;
+		}
+		pOctant->count = offset - pOctant->first;
+	}
 }
 
-void Octree::Insert(ColliderObject* pObj)
+uint64_t Octree::SortKey(const uint64_t key) const
 {
-	InsertObject(root, pObj);
+	// the octant's code padded out to the deepest level then its level, so an octant's bodies sort together,
+	// its subtree sorts straight after it, and it comes before a descendant that pads out to the same code
+	unsigned int level = 0;
+	while ((key >> (3 * (level + 1))) != 0)
+	{
+		++level;
+	}
+	const uint64_t code = key ^ (uint64_t(1) << (3 * level));
+	return (code << (3 * (maxDepth - level) + levelBits)) | level;
 }
 
-void Octree::TestCollisions()
+void Octree::BuildLinearOctants()
 {
-	TestAllCollisions(root);
+	// runs of equal keys are octants in depth first order, with every ancestor before its descendants,
+	// so the octants still open when a run starts are exactly its ancestors holding bodies
+	linearOctants.clear();
+	openOctants.clear();
+	for (unsigned int first = 0; first < bodyCount;)
+	{
+		const uint64_t key = sortEntries[first].key;
+		unsigned int end = first;
+		for (; end < bodyCount && sortEntries[end].key == key; ++end)
+		{
+			members[end] = sortEntries[end].id;
+		}
 
-	std::unique_lock<std::mutex> lock(queueMutex);
-	collisionsTested.wait(lock, [this]() { return octantQueue.empty() && (busyThreads == 0); });
-}
+		// an open octant holds this one if their codes match down to its level
+		while (!openOctants.empty())
+		{
+			const uint64_t openKey = linearOctants[openOctants.back()].key;
+			const unsigned int shift = 3 * (maxDepth - static_cast<unsigned int>(openKey & ((1 << levelBits) - 1))) + levelBits;
+			if ((openKey >> shift) == (key >> shift)) break;
+			openOctants.pop_back();
+		}
 
-void Octree::ClearLists()
-{
-	ClearList(root);
+		const unsigned int parent = openOctants.empty() ? noParent : openOctants.back();
+		openOctants.push_back(static_cast<unsigned int>(linearOctants.size()));
+		linearOctants.push_back(LinearOctant{ key, first, end - first, parent });
+		first = end;
+	}
 }
 
-#ifdef _DEBUG
-void* Octree::Octant::operator new(size_t size)
+void Octree::SizeHistograms()
 {
-	return ::operator new(size, MemoryManager::TrackerIndex::Octant);
+	// adaptive and sparse octrees can have grown since the last frame
+	for (std::vector<BinEntry>& histogram : binHistograms)
+	{
+		if (histogram.size() != octants.size())
+		{
+			histogram.resize(octants.size(), BinEntry{ 0, 0 });
+		}
+	}
 }
-#endif
 
-Octree::Octant::Octant(Vec3 centre, Octant* parent) :
-	centre(centre)
+void Octree::ScatterBin(const unsigned int bin)
 {
-	children = std::array<Octant*, 8>();
-	for (Octant*& child : children)
+	// a linear octree's members were placed by its sort
+	if (layout == OctreeLayout::Linear) return;
+
+	// bins scatter their bodies into their own slots so no locks are needed,
+	// and bodies in an octant stay in id order whatever the thread count
+	std::vector<BinEntry>& histogram = binHistograms[bin];
+	for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
 	{
-		child = nullptr;
+		members[histogram[bodyOctants[id]].count++] = id;
 	}
-	pObjects = nullptr;
-	pParent = parent;
 }
 
-void Octree::Octant::AddToList(ColliderObject* pObj)
+unsigned int Octree::GatherRegions()
 {
-	std::lock_guard<std::mutex> guard(listMutex);
-	pObj->pNext = pObjects;
-	pObjects = pObj;
+	// a linear octree's octants are already in depth first order
+	if (layout == OctreeLayout::Linear) return RegionCount();
+
+	activeOctants.clear();
+	GatherActive(root);
+	return static_cast<unsigned int>(activeOctants.size());
 }
 
-void Octree::Octant::TestCollisions()
+void Octree::FindRegionPairs(const unsigned int activeIndex, std::vector<CollisionPair>& pairs) const
 {
-	std::array<Octant*, maxOctantDepth> others{};
-	unsigned int otherCount = 0;
-
-	for (Octant* other = this; other; other = other->pParent)
+	// a tight octant's bodies can only touch bodies in the same octant or its ancestors,
+	// a loose one's can touch any octant whose loose bounds overlap its own
+	thread_local std::vector<PairSweep::Range> others;
+	others.clear();
+	PairSweep::Range own;
+	if (layout == OctreeLayout::Linear)
 	{
-		others[otherCount++] = other;
+		const LinearOctant& octant = linearOctants[activeIndex];
+		own = PairSweep::Range{ octant.first, octant.count };
+		for (unsigned int parent = octant.parent; parent != noParent; parent = linearOctants[parent].parent)
+		{
+			others.push_back(PairSweep::Range{ linearOctants[parent].first, linearOctants[parent].count });
+		}
 	}
-	unsigned int maxOthers = otherCount;
-
-	for (unsigned int index = 0; otherCount != 0; index = (index+1) % maxOthers)
+	else
 	{
-		if (others[index] == nullptr) continue;
-
-		std::lock_guard<std::mutex> guard{ listMutex };
-		Octant* other = others[index];
-
-		ColliderObject* objA, * objB;
-		if (this != other)
+		const Octant* pOctant = activeOctants[activeIndex];
+		own = PairSweep::Range{ pOctant->first, pOctant->Count(epoch) };
+		if (looseness > 1.0f)
 		{
-			std::unique_lock<std::mutex> lock{ other->listMutex, std::defer_lock };
-			if (lock.try_lock())
+			GatherOverlapping(pOctant, others);
+		}
+		else
+		{
+			for (const Octant* pOther = pOctant->Parent(); pOther != nullptr; pOther = pOther->Parent())
 			{
-				for (objA = other->pObjects; objA; objA = objA->pNext)
+				if (pOther->Count(epoch) != 0)
 				{
-					for (objB = pObjects; objB; objB = objB->pNext)
-					{
-						ColliderObject::TestCollision(objA, objB);
-					}
+					others.push_back(PairSweep::Range{ pOther->first, pOther->Count(epoch) });
 				}
 			}
-			else
+		}
+	}
+
+	PairSweep::Sweep(colliders, members.data(), own, others, pairs);
+}
+
+void Octree::GatherOverlapping(const Octant* pOctant, std::vector<PairSweep::Range>& others) const
+{
+	// overlapping is symmetric, so each pair of octants is only paired from the one with the lower index
+	const PhysicsKernels::Bounds& bounds = looseBounds[pOctant->index];
+	thread_local std::vector<const Octant*> stack;
+	stack.assign(1, root);
+	while (!stack.empty())
+	{
+		const Octant* pOther = stack.back();
+		stack.pop_back();
+		if (pOther->index > pOctant->index && pOther->Count(epoch) != 0)
+		{
+			others.push_back(PairSweep::Range{ pOther->first, pOther->Count(epoch) });
+		}
+
+		// children's loose bounds lie within their parent's, so a subtree that misses can be skipped
+		const unsigned char childMask = pOther->ChildMask(epoch);
+		for (int c = 0; c < 8; c++)
+		{
+			if ((childMask & (1 << c)) && looseBounds[pOther->children[c]->index].Overlaps(bounds))
 			{
-				continue;
+				stack.push_back(pOther->children[c]);
 			}
 		}
-		else
+	}
+}
+
+void Octree::Adapt()
+{
+	if (layout == OctreeLayout::Full || layout == OctreeLayout::Linear) return;
+	if (layout == OctreeLayout::Sparse)
+	{
+		Prune();
+		return;
+	}
+
+	// decide every change from this frame's counts before touching the tree
+	splitOctants.clear();
+	mergeOctants.clear();
+	for (Octant* pOctant : octants)
+	{
+		if (pOctant == nullptr) continue;
+
+		if (pOctant->children[0] == nullptr)
 		{
-			for (objA = other->pObjects; objA; objA = objA->pNext)
+			if (pOctant->depth < maxDepth && pOctant->Count(epoch) > splitCount)
 			{
-				for (objB = objA->pNext; objB; objB = objB->pNext) // only check each once if is same octant
-				{
-					ColliderObject::TestCollision(objA, objB);
-				}
+				splitOctants.push_back(pOctant);
 			}
+			continue;
 		}
 
-		others[index] = nullptr;
-		--otherCount;
+		// only octants whose children are leaves can merge, so an empty subtree collapses a level at a time
+		unsigned int subtreeCount = pOctant->Count(epoch);
+		bool childrenAreLeaves = true;
+		for (const Octant* pChild : pOctant->children)
+		{
+			childrenAreLeaves = childrenAreLeaves && pChild->children[0] == nullptr;
+			subtreeCount += pChild->Count(epoch);
+		}
+
+		pOctant->quietFrames = childrenAreLeaves && subtreeCount < mergeCount ? pOctant->quietFrames + 1 : 0;
+		if (pOctant->quietFrames >= mergeDelay)
+		{
+			mergeOctants.push_back(pOctant);
+		}
 	}
+
+	// mergeCount is below splitCount, so no octant is split and merged in the same frame
+	for (Octant* pOctant : mergeOctants)
+	{
+		Merge(pOctant);
+		pOctant->quietFrames = 0;
+	}
+	for (Octant* pOctant : splitOctants)
+	{
+		Split(pOctant, rootHalfExtent / static_cast<float>(1u << (pOctant->depth + 1)));
+	}
+
+	treeChanged = !mergeOctants.empty() || !splitOctants.empty();
+}
+
+#ifdef _DEBUG
+void* Octree::Octant::operator new(size_t size)
+{
+	return ::operator new(size, MemoryManager::TrackerIndex::Octant);
+}
+#endif
+
+Octree::Octant::Octant(Vec3 centre, Octant* parent, const unsigned int index, const unsigned int depth) :
+	centre(centre), index(index), depth(depth)
+{
+	children = std::array<Octant*, 8>();
+	for (Octant*& child : children)
+	{
+		child = nullptr;
+	}
+	first = 0;
+	count = 0;
+	epoch = 0;
+	quietFrames = 0;
+	pParent = parent;
+	childMask = 0;
+	maskEpoch = 0;
 }
 
-void Octree::Octant::ClearList()
+void Octree::Octant::MarkOccupied(const unsigned int frame)
 {
-	std::lock_guard<std::mutex> guard(listMutex);
-	pObjects = nullptr;
+	// walk up setting this branch's bit, stopping at the first ancestor that already had it set
+	const Octant* pChild = this;
+	for (Octant* pOctant = pParent; pOctant != nullptr; pChild = pOctant, pOctant = pOctant->pParent)
+	{
+		if (pOctant->maskEpoch != frame)
+		{
+			pOctant->maskEpoch = frame;
+			pOctant->childMask = 0;
+		}
+
+		unsigned char bit = 0;
+		for (unsigned int i = 0; i < 8; i++)
+		{
+			if (pOctant->children[i] == pChild) bit = 1 << i;
+		}
+
+		if (pOctant->childMask & bit) return;
+		pOctant->childMask |= bit;
+	}
 }
\ No newline at end of file
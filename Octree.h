@@ -1,15 +1,15 @@
 #pragma once
 #include "Vec3.h"
 #include "globals.h"
+#include "Broadphase.h"
+#include "OctantMap.h"
+#include "PairSweep.h"
+#include "RadixSort.h"
 #include <array>
-#include <mutex>
-#include <thread>
-#include <atomic>
-#include <queue>
+#include <cstdint>
+#include <vector>
 
-class ColliderObject;
-
-class Octree
+class Octree : public Broadphase
 {
 public:
 	struct Octant
@@ -22,46 +22,169 @@ public:
 		void* operator new (size_t size);
 #endif
 
-		Octant(Vec3 centre, Octant* parent);
-		void AddToList(ColliderObject* pObj);
-		void TestCollisions();
-		void ClearList();
+		Octant(Vec3 centre, Octant* parent, const unsigned int index, const unsigned int depth);
+
+		inline Octant* Parent() const { return pParent; }
+
+		// number of bodies in this octant, the range is stale unless it was filled in the given frame
+		inline unsigned int Count(const unsigned int frame) const { return epoch == frame ? count : 0; }
+
+		// bit i is set if child i's subtree holds any bodies in the given frame
+		inline unsigned char ChildMask(const unsigned int frame) const { return maskEpoch == frame ? childMask : 0; }
+
+		/// <summary>
+		/// Marks this octant as occupied in each of its ancestors' child masks
+		/// </summary>
+		void MarkOccupied(const unsigned int frame);
+
+		const unsigned int index; // position in the octree's octant list and in each bin's histogram
+		const unsigned int depth; // 0 for the root
+		unsigned int quietFrames; // frames in a row this octant's subtree has held fewer than mergeCount bodies, or been an empty leaf if sparse
+
+		// range of the octree's member list holding the bodies in this octant
+		unsigned int first;
+		unsigned int count;
+		unsigned int epoch; // frame the range was filled in
 
 	private:
-		ColliderObject* pObjects;
 		Octant* pParent;
-		std::mutex listMutex;
+		unsigned char childMask;
+		unsigned int maskEpoch; // frame the child mask was set in
 	};
 
 
-	Octree(const Vec3 position, const Vec3 extent, const unsigned int maxDepth);
+	/// <summary>
+	/// A looseness above 1 makes a loose octree, where each octant's bounds are grown by that factor and
+	/// bodies sink to the deepest octant that holds them by their centre, rather than stopping at the first
+	/// split plane they straddle. Octants then overlap their neighbours, so each octant's bodies are paired
+	/// with those of every octant whose loose bounds overlap its own.
+	/// <para>Adaptive and sparse octrees start as just the root and never go deeper than maxDepth. A sparse
+	/// octree's depth is only limited by its 64 bit codes, as the octants it makes all hold bodies.
+	/// A linear octree is always tight</para>
+	/// </summary>
+	Octree(ThreadPool& pool, ColliderStore& colliders, const Vec3 position, const Vec3 extent, const unsigned int maxDepth, const float looseness = 1.0f, const OctreeLayout layout = OctreeLayout::Full);
 	~Octree();
 
-	void Insert(ColliderObject* pObj);
-	void TestCollisions();
-	void ClearLists();
+	// the bins bin every body into the octant it fits in, leaving each octant's bodies contiguous in the member list
 
-private:
-	std::vector<std::thread> threads;
-	std::queue<Octant*> octantQueue;
-	std::mutex queueMutex;
-	std::condition_variable queueUpdateCondition;
+	/// <summary>
+	/// Empties every octant and sizes the bins for the bodies in the store
+	/// </summary>
+	void BeginBuild() override;
+
+	void CountBin(const unsigned int bin) override;
+	void PrefixSum() override;
+	void ScatterBin(const unsigned int bin) override;
+
+	/// <summary>
+	/// Collects the octants holding bodies this frame, the regions pairs are found in
+	/// </summary>
+	/// <returns>number of active octants</returns>
+	unsigned int GatherRegions() override;
+	inline unsigned int RegionCount() const override
+	{
+		return static_cast<unsigned int>(layout == OctreeLayout::Linear ? linearOctants.size() : activeOctants.size());
+	}
+
+	/// <summary>
+	/// Emits the candidate pairs of one active octant, every pair of bodies sharing an octant chain
+	/// </summary>
+	void FindRegionPairs(const unsigned int activeIndex, std::vector<CollisionPair>& pairs) const override;
 
-	std::condition_variable collisionsTested;
+	/// <summary>
+	/// Splits leaves holding more than splitCount bodies this frame, and merges the children back into
+	/// octants whose subtree has held fewer than mergeCount for mergeDelay frames. A sparse octree instead
+	/// removes leaves that have been empty for mergeDelay frames, and full and linear ones are left alone.
+	/// Must run after the frame's pairs are found and before the next BeginBuild
+	/// </summary>
+	void Adapt() override;
 
-	bool shouldTerminate = false;
-	unsigned int busyThreads = 0;
+	inline const char* Name() const override { return "octree"; }
 
-	void ThreadLoop();
+	inline unsigned int OctantCount() const
+	{
+		return static_cast<unsigned int>(layout == OctreeLayout::Linear ? linearOctants.size() : octants.size() - freeIndices.size());
+	}
+
+	// the gap between the two counts stops an octant near either one from splitting and merging every frame
+	static constexpr unsigned int splitCount = 32;
+	static constexpr unsigned int mergeCount = 8;
+	static constexpr unsigned int mergeDelay = 60;
 
 private:
 	Octant* root;
+	const float looseness;
+	const Vec3 rootHalfExtent;
+	std::vector<PhysicsKernels::Bounds> looseBounds; // bounds of every octant grown by looseness, only used by a loose octree
+
+	const OctreeLayout layout;
+	const unsigned int maxDepth;
+	bool treeChanged = true; // set by Adapt, sleeping bodies' cached octants may no longer exist. Nothing is cached before the first build
+	bool rebinSleeping = false; // this frame's bins find the octant of sleeping bodies as well
+	std::vector<Octant*> splitOctants; // octants Adapt changes this frame
+	std::vector<Octant*> mergeOctants;
+
+	OctantMap octantMap; // locational code to octant index, only filled for a sparse octree
+	std::vector<uint64_t> octantKeys; // locational code of every octant, indexed by Octant::index
+
+	// bodies whose octant didn't exist yet when their bin was counted, made by PrefixSum
+	struct MissingBody
+	{
+		unsigned int id;
+		uint64_t key;
+	};
+	std::vector<std::vector<MissingBody>> binMissing;
 
-	void InsertObject(Octant* pOctant, ColliderObject* pObj);
+	// a linear octree has no octants, each frame the bodies are radix sorted by their octant's sort key
+	// and each run of equal keys is an octant, see SortKey
+	struct LinearOctant
+	{
+		uint64_t key;
+		unsigned int first;
+		unsigned int count;
+		unsigned int parent; // nearest ancestor holding bodies, noParent if there is none
+	};
+	static constexpr unsigned int noParent = ~0u;
+	static constexpr unsigned int levelBits = 5; // low bits of a sort key holding the octant's level
+	std::vector<uint64_t> bodySortKeys; // sort key of each body, kept while it sleeps
+	std::vector<RadixSorter::Entry> sortEntries;
+	RadixSorter sorter;
+	std::vector<LinearOctant> linearOctants; // octants holding bodies this frame in depth first order
+	std::vector<unsigned int> openOctants; // linear octants whose subtree the scan is still inside
+
+	std::vector<Octant*> octants; // every octant, indexed by Octant::index, null where a merged octant was
+	std::vector<unsigned int> freeIndices; // indices of merged octants, reused by the next split
+	std::vector<unsigned int> members; // body ids grouped by octant
+	std::vector<unsigned int> bodyOctants; // index of the octant each body was binned into
+
+	// a histogram entry only counts if it was last touched this frame, so nothing needs zeroing
+	struct BinEntry
+	{
+		unsigned int epoch;
+		unsigned int count;
+	};
+	std::vector<std::vector<BinEntry>> binHistograms; // bodies per octant for each bin, then where the bin writes them
+	std::vector<std::vector<unsigned int>> binOctants; // octants each bin touched this frame
+	std::vector<Octant*> usedOctants; // octants with bodies this frame
+	std::vector<Octant*> activeOctants; // octants with bodies this frame in depth first order
+	unsigned int epoch = 1; // current frame, octants start at 0 so begin empty
+
+	Octant* FindOctant(Octant* pOctant, const Vec3& position, const Vec3& size) const;
+	Octant* FindLooseOctant(const Vec3& position, const Vec3& size) const;
+	void GatherOverlapping(const Octant* pOctant, std::vector<PairSweep::Range>& others) const;
+	uint64_t BodyKey(const Vec3& position, const Vec3& size) const;
+	uint64_t SortKey(const uint64_t key) const;
+	void BuildLinearOctants();
+	Octant* FindOrCreate(const uint64_t key);
 	void BuildTree(Octant* pCurrent, const Vec3 extent, const unsigned int depth, const unsigned int maxDepth);
-	void TestAllCollisions(Octant* pOctant);
+	Octant* CreateChild(Octant* pParent, const unsigned int child, const Vec3 halfExtent);
+	void DeleteOctant(Octant* pOctant);
+	void Split(Octant* pOctant, const Vec3 halfExtent);
+	void Merge(Octant* pOctant);
+	void Prune();
+	void SizeHistograms();
+	void GatherActive(Octant* pOctant);
 
 	void DeleteChildren(Octant* pOctant);
-	void ClearList(Octant* pOctant);
 
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "PairSweep.h"
+#include "ColliderStore.h"
+#include "PhysicsKernels.h"
+#include <algorithm>
+
+namespace PairSweep
+{
+	void Sweep(const ColliderStore& colliders, const unsigned int* members, const Range own, const std::vector<Range>& others, std::vector<CollisionPair>& pairs)
+	{
+		if (own.count == 0) return;
+
+		// members are sorted along x so each body only sweeps over the bodies that overlap it on that axis
+		struct SweepEntry
+		{
+			float minX, maxX;
+			unsigned int id;
+			bool asleep;
+		};
+		thread_local std::vector<SweepEntry> sweep;
+		sweep.clear();
+
+		// bounds around every body in own, bodies in other ranges outside
+		// of it can't collide with any of them so aren't worth emitting
+		PhysicsKernels::Bounds memberBounds = PhysicsKernels::Bounds::FromStore(colliders, members[own.first]);
+		bool allAsleep = true;
+		for (unsigned int i = own.first; i < own.first + own.count; ++i)
+		{
+			const PhysicsKernels::Bounds bounds = PhysicsKernels::Bounds::FromStore(colliders, members[i]);
+			memberBounds.Merge(bounds);
+			const bool asleep = colliders.asleep[members[i]] != 0;
+			allAsleep = allAsleep && asleep;
+			sweep.push_back(SweepEntry{ bounds.minX, bounds.maxX, members[i], asleep });
+		}
+		std::sort(sweep.begin(), sweep.end(), [](const SweepEntry& a, const SweepEntry& b) { return a.minX < b.minX; });
+		const size_t memberCount = sweep.size();
+
+		// pairs are grouped by their first body for the narrow phase,
+		// two sleeping bodies have already settled against each other so are never paired
+		for (const Range& other : others)
+		{
+			for (unsigned int i = other.first; i < other.first + other.count; ++i)
+			{
+				const unsigned int objA = members[i];
+				const bool asleep = colliders.asleep[objA] != 0;
+				if (asleep && allAsleep) continue;
+
+				const PhysicsKernels::Bounds bounds = PhysicsKernels::Bounds::FromStore(colliders, objA);
+				if (!memberBounds.Overlaps(bounds)) continue;
+
+				for (size_t b = 0; b < memberCount && sweep[b].minX < bounds.maxX; ++b)
+				{
+					if (bounds.minX < sweep[b].maxX && !(asleep && sweep[b].asleep))
+					{
+						pairs.push_back(CollisionPair{ objA, sweep[b].id });
+					}
+				}
+			}
+		}
+
+		if (allAsleep) return;
+
+		for (size_t a = 0; a < memberCount; ++a)
+		{
+			for (size_t b = a + 1; b < memberCount && sweep[b].minX < sweep[a].maxX; ++b) // only check each once if is same range
+			{
+				if (!(sweep[a].asleep && sweep[b].asleep))
+				{
+					pairs.push_back(CollisionPair{ sweep[a].id, sweep[b].id });
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "NarrowPhase.h"
+#include <vector>
+
+class ColliderStore;
+
+/// <summary>
+/// Candidate pair search shared by the broadphases, once they have grouped bodies into
+/// ranges of a member list that can only touch certain other ranges
+/// </summary>
+namespace PairSweep
+{
+	struct Range
+	{
+		unsigned int first;
+		unsigned int count;
+	};
+
+	/// <summary>
+	/// Emits the pairs of bodies in own, and between own and each of others, that overlap on the x axis.
+	/// Pairs are grouped by their first body for the narrow phase, and two sleeping bodies are never paired
+	/// </summary>
+	void Sweep(const ColliderStore& colliders, const unsigned int* members, const Range own, const std::vector<Range>& others, std::vector<CollisionPair>& pairs);
+}
@@ -0,0 +1,374 @@
+#include "PhysicsKernels.h"
+#include "ColliderObject.h"
+#include "ColliderStore.h"
+#include "globals.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace PhysicsKernels
+{
+	namespace
+	{
+		using IntegrateFunction = void (*)(ColliderStore&, const unsigned int, const unsigned int, const float);
+
+		InstructionSet DetectInstructionSet()
+		{
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			const bool sse2 = (info[3] & (1 << 26)) != 0;
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+
+			bool avx2 = false;
+			if (maxLeaf >= 7 && osxsave && avx)
+			{
+				// the os has to save the ymm registers on context switch for avx to be usable
+				const bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+				__cpuidex(info, 7, 0);
+				avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+			}
+#else
+			const bool sse2 = __builtin_cpu_supports("sse2");
+			const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+			if (avx2) return InstructionSet::AVX2;
+			if (sse2) return InstructionSet::SSE2;
+			return InstructionSet::Scalar;
+		}
+
+		void IntegrateScalar(ColliderStore& store, const unsigned int begin, const unsigned int end, const float deltaTime)
+		{
+			for (unsigned int id = begin; id < end; ++id)
+			{
+				if (store.asleep[id]) continue;
+				ColliderObject::update(store, id, deltaTime);
+			}
+		}
+
+		// sleep flags of the lanes starting at i packed into one integer, one byte per lane
+		template<class Flags>
+		inline Flags LoadSleepFlags(const ColliderStore& store, const unsigned int i)
+		{
+			Flags flags;
+			std::memcpy(&flags, store.asleep + i, sizeof(Flags));
+			return flags;
+		}
+
+		// bounds are handled with compare masks rather than branches, a velocity
+		// is negated by xoring in the sign bit only for lanes where the mask is set.
+		// Batches that are entirely asleep are skipped, and sleeping lanes of the rest keep their old values
+		void IntegrateSSE2(ColliderStore& store, const unsigned int begin, const unsigned int end, const float deltaTime)
+		{
+			const __m128 step = _mm_set1_ps(deltaTime);
+			const __m128 gravityStep = _mm_set1_ps(gravity * deltaTime);
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 floorDampening = _mm_set1_ps(0.7f);
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+			const __m128 lowX = _mm_set1_ps(minX), highX = _mm_set1_ps(maxX);
+			const __m128 lowY = _mm_set1_ps(minY), highY = _mm_set1_ps(maxY);
+			const __m128 lowZ = _mm_set1_ps(minZ), highZ = _mm_set1_ps(maxZ);
+
+			const __m128i zero = _mm_setzero_si128();
+
+			for (unsigned int i = begin; i < end; i += 4)
+			{
+				const uint32_t sleepFlags = LoadSleepFlags<uint32_t>(store, i);
+				if (sleepFlags == 0x01010101u) continue;
+
+				__m128 vx = _mm_load_ps(store.velocityX + i);
+				__m128 vy = _mm_load_ps(store.velocityY + i);
+				__m128 vz = _mm_load_ps(store.velocityZ + i);
+				__m128 px = _mm_load_ps(store.positionX + i);
+				__m128 py = _mm_load_ps(store.positionY + i);
+				__m128 pz = _mm_load_ps(store.positionZ + i);
+				const __m128 hx = _mm_mul_ps(_mm_load_ps(store.sizeX + i), half);
+				const __m128 hy = _mm_mul_ps(_mm_load_ps(store.sizeY + i), half);
+				const __m128 hz = _mm_mul_ps(_mm_load_ps(store.sizeZ + i), half);
+
+				vy = _mm_add_ps(vy, gravityStep);
+				px = _mm_add_ps(px, _mm_mul_ps(vx, step));
+				py = _mm_add_ps(py, _mm_mul_ps(vy, step));
+				pz = _mm_add_ps(pz, _mm_mul_ps(vz, step));
+
+				// floor, clamp on to it and bounce with dampening
+				const __m128 floorMask = _mm_cmplt_ps(_mm_sub_ps(py, hy), lowY);
+				py = _mm_or_ps(_mm_and_ps(floorMask, _mm_add_ps(lowY, hy)), _mm_andnot_ps(floorMask, py));
+				const __m128 bounced = _mm_mul_ps(_mm_xor_ps(vy, signMask), floorDampening);
+				vy = _mm_or_ps(_mm_and_ps(floorMask, bounced), _mm_andnot_ps(floorMask, vy));
+
+				// ceiling
+				const __m128 ceilingMask = _mm_cmpgt_ps(_mm_add_ps(py, hy), highY);
+				vy = _mm_xor_ps(vy, _mm_and_ps(ceilingMask, signMask));
+
+				// walls
+				const __m128 wallMaskX = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(px, hx), lowX), _mm_cmpgt_ps(_mm_add_ps(px, hx), highX));
+				const __m128 wallMaskZ = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(pz, hz), lowZ), _mm_cmpgt_ps(_mm_add_ps(pz, hz), highZ));
+				vx = _mm_xor_ps(vx, _mm_and_ps(wallMaskX, signMask));
+				vz = _mm_xor_ps(vz, _mm_and_ps(wallMaskZ, signMask));
+
+				if (sleepFlags != 0)
+				{
+					// widen the flag bytes to one per lane, awake lanes take the new values
+					const __m128i flags = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(sleepFlags)), zero), zero);
+					const __m128 awake = _mm_castsi128_ps(_mm_cmpeq_epi32(flags, zero));
+					vx = _mm_or_ps(_mm_and_ps(awake, vx), _mm_andnot_ps(awake, _mm_load_ps(store.velocityX + i)));
+					vy = _mm_or_ps(_mm_and_ps(awake, vy), _mm_andnot_ps(awake, _mm_load_ps(store.velocityY + i)));
+					vz = _mm_or_ps(_mm_and_ps(awake, vz), _mm_andnot_ps(awake, _mm_load_ps(store.velocityZ + i)));
+					px = _mm_or_ps(_mm_and_ps(awake, px), _mm_andnot_ps(awake, _mm_load_ps(store.positionX + i)));
+					py = _mm_or_ps(_mm_and_ps(awake, py), _mm_andnot_ps(awake, _mm_load_ps(store.positionY + i)));
+					pz = _mm_or_ps(_mm_and_ps(awake, pz), _mm_andnot_ps(awake, _mm_load_ps(store.positionZ + i)));
+				}
+
+				_mm_store_ps(store.velocityX + i, vx);
+				_mm_store_ps(store.velocityY + i, vy);
+				_mm_store_ps(store.velocityZ + i, vz);
+				_mm_store_ps(store.positionX + i, px);
+				_mm_store_ps(store.positionY + i, py);
+				_mm_store_ps(store.positionZ + i, pz);
+			}
+		}
+
+		AVX2_TARGET void IntegrateAVX2(ColliderStore& store, const unsigned int begin, const unsigned int end, const float deltaTime)
+		{
+			const __m256 step = _mm256_set1_ps(deltaTime);
+			const __m256 gravityStep = _mm256_set1_ps(gravity * deltaTime);
+			const __m256 half = _mm256_set1_ps(0.5f);
+			const __m256 floorDampening = _mm256_set1_ps(0.7f);
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+			const __m256 lowX = _mm256_set1_ps(minX), highX = _mm256_set1_ps(maxX);
+			const __m256 lowY = _mm256_set1_ps(minY), highY = _mm256_set1_ps(maxY);
+			const __m256 lowZ = _mm256_set1_ps(minZ), highZ = _mm256_set1_ps(maxZ);
+
+			const __m256i zero = _mm256_setzero_si256();
+
+			for (unsigned int i = begin; i < end; i += 8)
+			{
+				const uint64_t sleepFlags = LoadSleepFlags<uint64_t>(store, i);
+				if (sleepFlags == 0x0101010101010101ull) continue;
+
+				__m256 vx = _mm256_load_ps(store.velocityX + i);
+				__m256 vy = _mm256_load_ps(store.velocityY + i);
+				__m256 vz = _mm256_load_ps(store.velocityZ + i);
+				__m256 px = _mm256_load_ps(store.positionX + i);
+				__m256 py = _mm256_load_ps(store.positionY + i);
+				__m256 pz = _mm256_load_ps(store.positionZ + i);
+				const __m256 hx = _mm256_mul_ps(_mm256_load_ps(store.sizeX + i), half);
+				const __m256 hy = _mm256_mul_ps(_mm256_load_ps(store.sizeY + i), half);
+				const __m256 hz = _mm256_mul_ps(_mm256_load_ps(store.sizeZ + i), half);
+
+				vy = _mm256_add_ps(vy, gravityStep);
+				px = _mm256_add_ps(px, _mm256_mul_ps(vx, step));
+				py = _mm256_add_ps(py, _mm256_mul_ps(vy, step));
+				pz = _mm256_add_ps(pz, _mm256_mul_ps(vz, step));
+
+				// floor, clamp on to it and bounce with dampening
+				const __m256 floorMask = _mm256_cmp_ps(_mm256_sub_ps(py, hy), lowY, _CMP_LT_OQ);
+				py = _mm256_blendv_ps(py, _mm256_add_ps(lowY, hy), floorMask);
+				const __m256 bounced = _mm256_mul_ps(_mm256_xor_ps(vy, signMask), floorDampening);
+				vy = _mm256_blendv_ps(vy, bounced, floorMask);
+
+				// ceiling
+				const __m256 ceilingMask = _mm256_cmp_ps(_mm256_add_ps(py, hy), highY, _CMP_GT_OQ);
+				vy = _mm256_xor_ps(vy, _mm256_and_ps(ceilingMask, signMask));
+
+				// walls
+				const __m256 wallMaskX = _mm256_or_ps(
+					_mm256_cmp_ps(_mm256_sub_ps(px, hx), lowX, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_add_ps(px, hx), highX, _CMP_GT_OQ));
+				const __m256 wallMaskZ = _mm256_or_ps(
+					_mm256_cmp_ps(_mm256_sub_ps(pz, hz), lowZ, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_add_ps(pz, hz), highZ, _CMP_GT_OQ));
+				vx = _mm256_xor_ps(vx, _mm256_and_ps(wallMaskX, signMask));
+				vz = _mm256_xor_ps(vz, _mm256_and_ps(wallMaskZ, signMask));
+
+				if (sleepFlags != 0)
+				{
+					const __m256i flags = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(store.asleep + i)));
+					const __m256 awake = _mm256_castsi256_ps(_mm256_cmpeq_epi32(flags, zero));
+					vx = _mm256_blendv_ps(_mm256_load_ps(store.velocityX + i), vx, awake);
+					vy = _mm256_blendv_ps(_mm256_load_ps(store.velocityY + i), vy, awake);
+					vz = _mm256_blendv_ps(_mm256_load_ps(store.velocityZ + i), vz, awake);
+					px = _mm256_blendv_ps(_mm256_load_ps(store.positionX + i), px, awake);
+					py = _mm256_blendv_ps(_mm256_load_ps(store.positionY + i), py, awake);
+					pz = _mm256_blendv_ps(_mm256_load_ps(store.positionZ + i), pz, awake);
+				}
+
+				_mm256_store_ps(store.velocityX + i, vx);
+				_mm256_store_ps(store.velocityY + i, vy);
+				_mm256_store_ps(store.velocityZ + i, vz);
+				_mm256_store_ps(store.positionX + i, px);
+				_mm256_store_ps(store.positionY + i, py);
+				_mm256_store_ps(store.positionZ + i, pz);
+			}
+		}
+
+		unsigned int OverlapMaskScalar(const ColliderStore& store, const unsigned int id, const PackedBounds& candidates, const unsigned int first)
+		{
+			unsigned int mask = 0;
+			for (unsigned int i = 0; i < overlapBatch; ++i)
+			{
+				const unsigned int c = first + i;
+				const bool overlap =
+					std::abs(store.positionX[id] - candidates.positionX[c]) * 2 < store.sizeX[id] + candidates.sizeX[c] &&
+					std::abs(store.positionY[id] - candidates.positionY[c]) * 2 < store.sizeY[id] + candidates.sizeY[c] &&
+					std::abs(store.positionZ[id] - candidates.positionZ[c]) * 2 < store.sizeZ[id] + candidates.sizeZ[c];
+				mask |= (overlap ? 1u : 0u) << i;
+			}
+			return mask;
+		}
+
+		// abs(position - candidate) * 2 < size + candidate size, each step rounded the same as the scalar test
+		inline __m128 OverlapAxisSSE2(const float position, const float size, const float* candidatePosition, const float* candidateSize)
+		{
+			const __m128 distance = _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(_mm_set1_ps(position), _mm_loadu_ps(candidatePosition)));
+			return _mm_cmplt_ps(_mm_mul_ps(distance, _mm_set1_ps(2.0f)), _mm_add_ps(_mm_set1_ps(size), _mm_loadu_ps(candidateSize)));
+		}
+
+		unsigned int OverlapMaskSSE2(const ColliderStore& store, const unsigned int id, const PackedBounds& candidates, const unsigned int first)
+		{
+			unsigned int mask = 0;
+			for (unsigned int half = 0; half < overlapBatch; half += 4)
+			{
+				const unsigned int c = first + half;
+				const __m128 overlap = _mm_and_ps(_mm_and_ps(
+					OverlapAxisSSE2(store.positionX[id], store.sizeX[id], &candidates.positionX[c], &candidates.sizeX[c]),
+					OverlapAxisSSE2(store.positionY[id], store.sizeY[id], &candidates.positionY[c], &candidates.sizeY[c])),
+					OverlapAxisSSE2(store.positionZ[id], store.sizeZ[id], &candidates.positionZ[c], &candidates.sizeZ[c]));
+				mask |= (unsigned int)_mm_movemask_ps(overlap) << half;
+			}
+			return mask;
+		}
+
+		AVX2_TARGET inline __m256 OverlapAxisAVX2(const float position, const float size, const float* candidatePosition, const float* candidateSize)
+		{
+			const __m256 distance = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(_mm256_set1_ps(position), _mm256_loadu_ps(candidatePosition)));
+			return _mm256_cmp_ps(_mm256_mul_ps(distance, _mm256_set1_ps(2.0f)), _mm256_add_ps(_mm256_set1_ps(size), _mm256_loadu_ps(candidateSize)), _CMP_LT_OQ);
+		}
+
+		AVX2_TARGET unsigned int OverlapMaskAVX2(const ColliderStore& store, const unsigned int id, const PackedBounds& candidates, const unsigned int first)
+		{
+			const __m256 overlap = _mm256_and_ps(_mm256_and_ps(
+				OverlapAxisAVX2(store.positionX[id], store.sizeX[id], &candidates.positionX[first], &candidates.sizeX[first]),
+				OverlapAxisAVX2(store.positionY[id], store.sizeY[id], &candidates.positionY[first], &candidates.sizeY[first])),
+				OverlapAxisAVX2(store.positionZ[id], store.sizeZ[id], &candidates.positionZ[first], &candidates.sizeZ[first]));
+			return (unsigned int)_mm256_movemask_ps(overlap);
+		}
+
+		using OverlapFunction = unsigned int (*)(const ColliderStore&, const unsigned int, const PackedBounds&, const unsigned int);
+
+		const InstructionSet instructionSet = DetectInstructionSet();
+
+		IntegrateFunction SelectIntegrate()
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::AVX2:
+				return IntegrateAVX2;
+			case InstructionSet::SSE2:
+				return IntegrateSSE2;
+			default:
+				return IntegrateScalar;
+			}
+		}
+
+		OverlapFunction SelectOverlapMask()
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::AVX2:
+				return OverlapMaskAVX2;
+			case InstructionSet::SSE2:
+				return OverlapMaskSSE2;
+			default:
+				return OverlapMaskScalar;
+			}
+		}
+
+		const IntegrateFunction integrate = SelectIntegrate();
+		const OverlapFunction overlapMask = SelectOverlapMask();
+	}
+
+	void Bounds::Merge(const Bounds& other)
+	{
+		minX = std::min(minX, other.minX); minY = std::min(minY, other.minY); minZ = std::min(minZ, other.minZ);
+		maxX = std::max(maxX, other.maxX); maxY = std::max(maxY, other.maxY); maxZ = std::max(maxZ, other.maxZ);
+	}
+
+	void PackedBounds::Clear()
+	{
+		positionX.clear(); positionY.clear(); positionZ.clear();
+		sizeX.clear(); sizeY.clear(); sizeZ.clear();
+		ids.clear();
+		count = 0;
+	}
+
+	void PackedBounds::Add(const ColliderStore& store, const unsigned int id)
+	{
+		positionX.push_back(store.positionX[id]); positionY.push_back(store.positionY[id]); positionZ.push_back(store.positionZ[id]);
+		sizeX.push_back(store.sizeX[id]); sizeY.push_back(store.sizeY[id]); sizeZ.push_back(store.sizeZ[id]);
+		ids.push_back(id);
+		++count;
+	}
+
+	void PackedBounds::Pad()
+	{
+		// an empty body at infinity is infinitely far from anything
+		const float infinity = std::numeric_limits<float>::infinity();
+		positionX.resize(count + overlapBatch, infinity); positionY.resize(count + overlapBatch, infinity); positionZ.resize(count + overlapBatch, infinity);
+		sizeX.resize(count + overlapBatch, 0.0f); sizeY.resize(count + overlapBatch, 0.0f); sizeZ.resize(count + overlapBatch, 0.0f);
+	}
+
+	InstructionSet GetInstructionSet()
+	{
+		return instructionSet;
+	}
+
+	const char* GetInstructionSetName()
+	{
+		switch (instructionSet)
+		{
+		case InstructionSet::AVX2:
+			return "AVX2";
+		case InstructionSet::SSE2:
+			return "SSE2";
+		default:
+			return "Scalar";
+		}
+	}
+
+	void Integrate(ColliderStore& store, const unsigned int begin, unsigned int end, const float deltaTime)
+	{
+		// an empty range may start mid batch, rounding its end up would touch the previous range's batch
+		if (begin >= end) return;
+
+		// scalar path works on exact ids, batched paths on whole batches loaded from aligned addresses
+		assert(begin % ColliderStore::batchWidth == 0);
+		if (instructionSet != InstructionSet::Scalar)
+		{
+			end = (end + ColliderStore::batchWidth - 1) & ~(unsigned int)(ColliderStore::batchWidth - 1);
+		}
+
+		integrate(store, begin, end, deltaTime);
+	}
+
+	unsigned int OverlapMask(const ColliderStore& store, const unsigned int id, const PackedBounds& candidates, const unsigned int first)
+	{
+		return overlapMask(store, id, candidates, first);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "ColliderStore.h"
+#include <vector>
+
+/// <summary>
+/// Batched physics kernels over a ColliderStore. The widest instruction set the cpu supports
+/// is picked once at startup with cpuid, with a scalar fallback
+/// </summary>
+namespace PhysicsKernels
+{
+	enum class InstructionSet
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	// amount of candidates OverlapMask tests at once, whatever the instruction set
+	constexpr unsigned int overlapBatch = 8;
+
+	struct Bounds
+	{
+		float minX, minY, minZ;
+		float maxX, maxY, maxZ;
+
+		static inline Bounds FromStore(const ColliderStore& store, const unsigned int id)
+		{
+			const float halfX = store.sizeX[id] * 0.5f;
+			const float halfY = store.sizeY[id] * 0.5f;
+			const float halfZ = store.sizeZ[id] * 0.5f;
+			return Bounds{
+				store.positionX[id] - halfX, store.positionY[id] - halfY, store.positionZ[id] - halfZ,
+				store.positionX[id] + halfX, store.positionY[id] + halfY, store.positionZ[id] + halfZ
+			};
+		}
+
+		inline bool Overlaps(const Bounds& other) const
+		{
+			return minX < other.maxX && other.minX < maxX &&
+				minY < other.maxY && other.minY < maxY &&
+				minZ < other.maxZ && other.minZ < maxZ;
+		}
+
+		// grows to contain other as well
+		void Merge(const Bounds& other);
+	};
+
+	/// <summary>
+	/// Positions and sizes of a set of bodies packed into separate arrays, always followed by
+	/// a batch of bodies at infinity so a batch can be read from any real candidate
+	/// </summary>
+	struct PackedBounds
+	{
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> sizeX, sizeY, sizeZ;
+		std::vector<unsigned int> ids;
+
+		inline unsigned int Count() const { return count; }
+
+		void Clear();
+		void Add(const ColliderStore& store, const unsigned int id);
+
+		/// <summary>
+		/// Appends the bodies at infinity, call after the last Add and before testing
+		/// </summary>
+		void Pad();
+
+	private:
+		unsigned int count = 0;
+	};
+
+	InstructionSet GetInstructionSet();
+	const char* GetInstructionSetName();
+
+	/// <summary>
+	/// Applies gravity, integrates position and bounces off the world bounds for bodies in [begin, end).
+	/// begin must be a multiple of ColliderStore::batchWidth, end is rounded up to a whole batch
+	/// (the padding past the last body is always allocated and never read as a real body)
+	/// </summary>
+	void Integrate(ColliderStore& store, const unsigned int begin, const unsigned int end, const float deltaTime);
+
+	/// <summary>
+	/// Tests body id against the overlapBatch candidates starting at first, with the same
+	/// abs(pa - pb) * 2 < sa + sb test as ColliderObject::checkCollision so contacts exactly at touching match it
+	/// </summary>
+	/// <returns>bitmask with bit i set if the body overlaps candidate first + i</returns>
+	unsigned int OverlapMask(const ColliderStore& store, const unsigned int id, const PackedBounds& candidates, const unsigned int first);
+}
@@ -0,0 +1,57 @@
+#include "RadixSort.h"
+#include <algorithm>
+
+void RadixSorter::Sort(ThreadPool& pool, std::vector<Entry>& entries, const unsigned int keyBits)
+{
+	const unsigned int count = static_cast<unsigned int>(entries.size());
+	const unsigned int chunkCount = pool.ThreadCount();
+	const unsigned int chunkSize = (count + chunkCount - 1) / chunkCount;
+	histograms.resize(chunkCount);
+	buffer.resize(count);
+
+	for (unsigned int shift = 0; shift < keyBits; shift += radixBits)
+	{
+		pool.ParallelFor(chunkCount, 1, [&, shift](const unsigned int chunk, const unsigned int) {
+			std::array<unsigned int, radixSize>& histogram = histograms[chunk];
+			histogram.fill(0);
+			for (unsigned int i = chunk * chunkSize; i < std::min((chunk + 1) * chunkSize, count); ++i)
+			{
+				++histogram[(entries[i].key >> shift) & (radixSize - 1)];
+			}
+		});
+
+		// a digit every key shares wouldn't move anything, which is common for the top digits
+		bool shared = false;
+		for (unsigned int digit = 0; digit < radixSize && !shared; ++digit)
+		{
+			unsigned int total = 0;
+			for (unsigned int chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				total += histograms[chunk][digit];
+			}
+			shared = total == count;
+		}
+		if (shared) continue;
+
+		// prefix sum over digits then chunks turns the counts into where each chunk writes each digit
+		unsigned int offset = 0;
+		for (unsigned int digit = 0; digit < radixSize; ++digit)
+		{
+			for (unsigned int chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				const unsigned int digitCount = histograms[chunk][digit];
+				histograms[chunk][digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		pool.ParallelFor(chunkCount, 1, [&, shift](const unsigned int chunk, const unsigned int) {
+			std::array<unsigned int, radixSize>& histogram = histograms[chunk];
+			for (unsigned int i = chunk * chunkSize; i < std::min((chunk + 1) * chunkSize, count); ++i)
+			{
+				buffer[histogram[(entries[i].key >> shift) & (radixSize - 1)]++] = entries[i];
+			}
+		});
+		entries.swap(buffer);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "ThreadPool.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Least significant digit first radix sort of ids by 64 bit keys. Each pass counts and scatters the
+/// entries in one chunk per thread of the pool. Passes are stable, so entries with equal keys keep the
+/// order they were given in whatever the thread count
+/// </summary>
+class RadixSorter
+{
+public:
+	struct Entry
+	{
+		uint64_t key;
+		unsigned int id;
+	};
+
+	/// <summary>
+	/// Sorts entries by the low keyBits bits of their keys, higher bits must be 0. Can be called from
+	/// inside a task of the pool
+	/// </summary>
+	void Sort(ThreadPool& pool, std::vector<Entry>& entries, const unsigned int keyBits);
+
+private:
+	static constexpr unsigned int radixBits = 8; // bits sorted by each pass
+	static constexpr unsigned int radixSize = 1 << radixBits;
+
+	std::vector<Entry> buffer; // each pass scatters into here then swaps
+	std::vector<std::array<unsigned int, radixSize>> histograms; // digits counted by each chunk, then where it writes them
+};
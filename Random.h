@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+/// <summary>
+/// Small xorshift random number generator, used instead of rand so a run can be repeated from its seed
+/// </summary>
+class Random
+{
+public:
+	Random(const uint32_t seed = 1) { Seed(seed); }
+
+	// xorshift can't leave a state of 0 so it is swapped for another constant
+	inline void Seed(const uint32_t seed) { state = seed != 0 ? seed : 0x9E3779B9u; }
+
+	inline uint32_t Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// uniform in [0, 1)
+	inline float NextFloat()
+	{
+		return (Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+private:
+	uint32_t state;
+};
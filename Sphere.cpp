@@ -1,10 +0,0 @@
-#include "Sphere.h"
-#include "MemoryOperators.h"
-#include "TrackerIndex.h"
-
-#ifdef _DEBUG
-void* Sphere::operator new(size_t size)
-{
-	return ::operator new(size, MemoryManager::TrackerIndex::Sphere);
-}
-#endif
\ No newline at end of file
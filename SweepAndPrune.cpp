@@ -0,0 +1,250 @@
+#include "SweepAndPrune.h"
+#include "ColliderStore.h"
+#include <limits>
+
+constexpr unsigned int SweepAndPrune::pairSliceSize;
+constexpr float SweepAndPrune::axisSwitchRatio;
+
+namespace
+{
+	inline float AxisMin(const PhysicsKernels::Bounds& bounds, const unsigned int axis)
+	{
+		return axis == 0 ? bounds.minX : axis == 1 ? bounds.minY : bounds.minZ;
+	}
+
+	inline float AxisMax(const PhysicsKernels::Bounds& bounds, const unsigned int axis)
+	{
+		return axis == 0 ? bounds.maxX : axis == 1 ? bounds.maxY : bounds.maxZ;
+	}
+}
+
+SweepAndPrune::SweepAndPrune(ThreadPool& pool, ColliderStore& colliders) :
+	Broadphase(pool, colliders)
+{
+}
+
+void SweepAndPrune::BeginBuild()
+{
+	SizeBins();
+	binMoments.resize(binCount);
+	bodyBounds.resize(bodyCount);
+
+	if (rebuild) return;
+
+	// new bodies start at the back of the list overlapping nothing, and are sorted into place like any other move
+	for (unsigned int id = trackedCount; id < bodyCount; ++id)
+	{
+		minEndpoints.push_back(static_cast<unsigned int>(endpoints.size()));
+		endpoints.push_back(Endpoint{ std::numeric_limits<float>::max(), id, 0 });
+		maxEndpoints.push_back(static_cast<unsigned int>(endpoints.size()));
+		endpoints.push_back(Endpoint{ std::numeric_limits<float>::max(), id, 1 });
+	}
+	trackedCount = std::max(trackedCount, bodyCount);
+
+	// removed bodies are sent to the back to be dropped after sorting. Their max sorts before their min,
+	// so on the way they stop overlapping everything, including each other
+	for (unsigned int id = bodyCount; id < trackedCount; ++id)
+	{
+		endpoints[minEndpoints[id]].value = std::numeric_limits<float>::infinity();
+		endpoints[maxEndpoints[id]].value = std::numeric_limits<float>::max();
+	}
+}
+
+void SweepAndPrune::CountBin(const unsigned int bin)
+{
+	std::array<double, 6>& moments = binMoments[bin];
+	moments.fill(0.0);
+	for (unsigned int id = BinBegin(bin); id < BinEnd(bin); ++id)
+	{
+		const Vec3 position = colliders.Position(id);
+		const PhysicsKernels::Bounds bounds = PhysicsKernels::Bounds::FromStore(colliders, id);
+		bodyBounds[id] = bounds;
+		for (int i = 0; i < 3; i++)
+		{
+			moments[i] += position[i];
+			moments[3 + i] += static_cast<double>(position[i]) * position[i];
+		}
+
+		// a rebuild makes its own endpoints from the bounds
+		if (!rebuild)
+		{
+			endpoints[minEndpoints[id]].value = AxisMin(bounds, axis);
+			endpoints[maxEndpoints[id]].value = AxisMax(bounds, axis);
+		}
+	}
+}
+
+void SweepAndPrune::PrefixSum()
+{
+	double moments[6] = { 0.0 };
+	for (const std::array<double, 6>& binMoment : binMoments)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			moments[i] += binMoment[i];
+		}
+	}
+
+	// switching axis means sorting from scratch, so only do it once another axis is clearly better
+	if (bodyCount > 0)
+	{
+		double variances[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const double mean = moments[i] / bodyCount;
+			variances[i] = moments[3 + i] / bodyCount - mean * mean;
+		}
+		const unsigned int widest = static_cast<unsigned int>(std::max_element(variances, variances + 3) - variances);
+		if (widest != axis && (rebuild || variances[widest] > variances[axis] * axisSwitchRatio))
+		{
+			axis = widest;
+			rebuild = true;
+		}
+	}
+
+	if (rebuild)
+	{
+		Rebuild();
+		rebuild = false;
+		return;
+	}
+
+	InsertionSort();
+	if (trackedCount > bodyCount)
+	{
+		endpoints.resize(2 * bodyCount);
+		minEndpoints.resize(bodyCount);
+		maxEndpoints.resize(bodyCount);
+		trackedCount = bodyCount;
+	}
+}
+
+void SweepAndPrune::InsertionSort()
+{
+	// each endpoint steps back past the larger ones before it, every step is a min and a max
+	// trading places is a pair starting or stopping overlapping
+	const unsigned int count = static_cast<unsigned int>(endpoints.size());
+	for (unsigned int i = 1; i < count; ++i)
+	{
+		const Endpoint moving = endpoints[i];
+		unsigned int j = i;
+		for (; j > 0 && endpoints[j - 1].value > moving.value; --j)
+		{
+			const Endpoint passed = endpoints[j - 1];
+			if (passed.isMax != moving.isMax && passed.body != moving.body)
+			{
+				if (moving.isMax)
+				{
+					RemovePair(moving.body, passed.body);
+				}
+				else
+				{
+					AddPair(moving.body, passed.body);
+				}
+			}
+			endpoints[j] = passed;
+			(passed.isMax ? maxEndpoints : minEndpoints)[passed.body] = j;
+		}
+
+		if (j != i)
+		{
+			endpoints[j] = moving;
+			(moving.isMax ? maxEndpoints : minEndpoints)[moving.body] = j;
+		}
+	}
+}
+
+void SweepAndPrune::Rebuild()
+{
+	endpoints.resize(2 * bodyCount);
+	minEndpoints.resize(bodyCount);
+	maxEndpoints.resize(bodyCount);
+	trackedCount = bodyCount;
+	for (unsigned int id = 0; id < bodyCount; ++id)
+	{
+		endpoints[2 * id] = Endpoint{ AxisMin(bodyBounds[id], axis), id, 0 };
+		endpoints[2 * id + 1] = Endpoint{ AxisMax(bodyBounds[id], axis), id, 1 };
+	}
+	std::sort(endpoints.begin(), endpoints.end(), [](const Endpoint& a, const Endpoint& b) {
+		return a.value < b.value || (a.value == b.value && a.isMax < b.isMax);
+	});
+
+	// sweep the list once, each body overlaps every body still open when its min is reached
+	axisPairs.clear();
+	pairIndices = OctantMap();
+	std::vector<unsigned int> open;
+	std::vector<unsigned int> openSlots(bodyCount);
+	for (unsigned int i = 0; i < endpoints.size(); ++i)
+	{
+		const unsigned int body = endpoints[i].body;
+		if (endpoints[i].isMax)
+		{
+			maxEndpoints[body] = i;
+			open[openSlots[body]] = open.back();
+			openSlots[open.back()] = openSlots[body];
+			open.pop_back();
+		}
+		else
+		{
+			minEndpoints[body] = i;
+			for (const unsigned int other : open)
+			{
+				AddPair(body, other);
+			}
+			openSlots[body] = static_cast<unsigned int>(open.size());
+			open.push_back(body);
+		}
+	}
+}
+
+void SweepAndPrune::AddPair(const unsigned int a, const unsigned int b)
+{
+	const uint64_t key = PairKey(a, b);
+	if (pairIndices.Find(key) != OctantMap::noOctant) return;
+
+	pairIndices.Insert(key, static_cast<unsigned int>(axisPairs.size()));
+	axisPairs.push_back(a < b ? CollisionPair{ a, b } : CollisionPair{ b, a });
+}
+
+void SweepAndPrune::RemovePair(const unsigned int a, const unsigned int b)
+{
+	const uint64_t key = PairKey(a, b);
+	const unsigned int index = pairIndices.Find(key);
+	if (index == OctantMap::noOctant) return;
+
+	// the last pair fills the gap so the list stays dense
+	const CollisionPair last = axisPairs.back();
+	axisPairs[index] = last;
+	axisPairs.pop_back();
+	pairIndices.Erase(key);
+	if (index < axisPairs.size())
+	{
+		pairIndices.Erase(PairKey(last.a, last.b));
+		pairIndices.Insert(PairKey(last.a, last.b), index);
+	}
+}
+
+unsigned int SweepAndPrune::GatherRegions()
+{
+	regionCount = static_cast<unsigned int>((axisPairs.size() + pairSliceSize - 1) / pairSliceSize);
+	return regionCount;
+}
+
+void SweepAndPrune::FindRegionPairs(const unsigned int region, std::vector<CollisionPair>& pairs) const
+{
+	// most pairs only overlap along axis, so the tests are combined without branching to keep them predictable.
+	// Two sleeping bodies have already settled against each other so are never paired
+	const unsigned int end = std::min((region + 1) * pairSliceSize, static_cast<unsigned int>(axisPairs.size()));
+	for (unsigned int i = region * pairSliceSize; i < end; ++i)
+	{
+		const CollisionPair& pair = axisPairs[i];
+		const PhysicsKernels::Bounds& a = bodyBounds[pair.a];
+		const PhysicsKernels::Bounds& b = bodyBounds[pair.b];
+		const bool overlap = (a.minX < b.maxX) & (b.minX < a.maxX) & (a.minY < b.maxY) & (b.minY < a.maxY) &
+			(a.minZ < b.maxZ) & (b.minZ < a.maxZ) & ((colliders.asleep[pair.a] & colliders.asleep[pair.b]) == 0);
+		if (overlap)
+		{
+			pairs.push_back(pair);
+		}
+	}
+}
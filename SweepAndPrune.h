@@ -0,0 +1,95 @@
+#pragma once
+#include "Broadphase.h"
+#include "OctantMap.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Incremental sweep and prune broadphase. Keeps the min and max of every body along one axis in a sorted
+/// list, and the set of pairs whose intervals overlap on that axis. Bodies only move a little each step, so
+/// the list is sorted again by insertion sort, and every time a min passes a max or a max passes a min the
+/// pair of their bodies is added to or removed from the set. Sorting costs little more than the number of
+/// bodies that moved past each other. The axis is the one the bodies are most spread along, chosen again as
+/// they move
+/// </summary>
+class SweepAndPrune : public Broadphase
+{
+public:
+	SweepAndPrune(ThreadPool& pool, ColliderStore& colliders);
+
+	/// <summary>
+	/// Sizes the bins for the bodies in the store. Bodies added or removed since the last step are added to
+	/// or taken off the end of the list
+	/// </summary>
+	void BeginBuild() override;
+
+	/// <summary>
+	/// Moves the endpoints of each body in the bin to where the body is now, and adds the bin's bodies
+	/// to the spread along each axis and to the bounds pairs are tested with
+	/// </summary>
+	void CountBin(const unsigned int bin) override;
+
+	/// <summary>
+	/// Sorts the endpoints again and updates the pair set, or builds both from scratch when the axis changes
+	/// </summary>
+	void PrefixSum() override;
+
+	/// <summary>
+	/// Splits the pair set into regions of pairSliceSize pairs
+	/// </summary>
+	/// <returns>number of regions</returns>
+	unsigned int GatherRegions() override;
+	inline unsigned int RegionCount() const override { return regionCount; }
+
+	/// <summary>
+	/// Emits the pairs of one region whose bounds overlap on the other two axes as well
+	/// </summary>
+	void FindRegionPairs(const unsigned int region, std::vector<CollisionPair>& pairs) const override;
+
+	inline const char* Name() const override { return "sweep and prune"; }
+
+	inline unsigned int Axis() const { return axis; }
+	inline unsigned int PairCount() const { return static_cast<unsigned int>(axisPairs.size()); }
+
+	static constexpr unsigned int pairSliceSize = 512; // pairs emitted by one region task
+	static constexpr float axisSwitchRatio = 1.5f; // another axis must be this much more spread out to switch to it
+
+private:
+	struct Endpoint
+	{
+		float value;
+		unsigned int body : 31;
+		unsigned int isMax : 1;
+	};
+
+	unsigned int axis = 0;
+	bool rebuild = true; // the list and pair set are built from scratch next sort
+	std::vector<Endpoint> endpoints; // sorted by value along axis
+	std::vector<unsigned int> minEndpoints; // where each body's min and max are in endpoints
+	std::vector<unsigned int> maxEndpoints;
+	unsigned int trackedCount = 0; // bodies with endpoints in the list, those past bodyCount are being removed
+
+	// pairs of bodies overlapping along axis with the lower id first, found in the set by PairKey
+	std::vector<CollisionPair> axisPairs;
+	OctantMap pairIndices;
+
+	// bounds of every body this step, packed together as pairs read them in no particular order
+	std::vector<PhysicsKernels::Bounds> bodyBounds;
+
+	// sum and sum of squares of body positions along each axis for each bin, to find the axis of greatest variance
+	std::vector<std::array<double, 6>> binMoments;
+
+	unsigned int regionCount = 0;
+
+	static inline uint64_t PairKey(const unsigned int a, const unsigned int b)
+	{
+		// never 0 as the two ids differ, which is all the map needs of a key
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	void InsertionSort();
+	void Rebuild();
+	void AddPair(const unsigned int a, const unsigned int b);
+	void RemovePair(const unsigned int a, const unsigned int b);
+};
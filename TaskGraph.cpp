@@ -0,0 +1,114 @@
+#include "TaskGraph.h"
+#include <algorithm>
+
+TaskGraph::TaskGraph(ThreadPool& pool) :
+	pool(pool), nodesLeft(0)
+{
+}
+
+TaskGraph::NodeId TaskGraph::AddTask(const TaskFunction& function)
+{
+	const NodeId id = static_cast<NodeId>(nodes.size());
+	nodes.emplace_back(new Node());
+	Node& node = *nodes.back();
+
+	node.grainSize = 1;
+	node.function = [this, id, function](const unsigned int, const unsigned int, const unsigned int threadIndex) {
+		function(threadIndex);
+		Complete(id);
+	};
+	node.tasks.resize(1);
+	return id;
+}
+
+TaskGraph::NodeId TaskGraph::AddParallelTask(const CountFunction& count, const unsigned int grainSize, const ThreadPool::Function& function)
+{
+	const NodeId id = static_cast<NodeId>(nodes.size());
+	nodes.emplace_back(new Node());
+	Node& node = *nodes.back();
+
+	node.count = count;
+	node.grainSize = grainSize;
+	node.function = [this, id, function](const unsigned int begin, const unsigned int end, const unsigned int threadIndex) {
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			function(i, threadIndex);
+		}
+
+		// the last chunk to finish completes the node
+		if (nodes[id]->chunksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Complete(id);
+		}
+	};
+	node.tasks.resize(ThreadPool::maxTasks);
+	return id;
+}
+
+void TaskGraph::AddDependency(const NodeId before, const NodeId after)
+{
+	nodes[before]->dependents.push_back(after);
+	++nodes[after]->dependencyCount;
+}
+
+void TaskGraph::Run()
+{
+	if (nodes.empty()) return;
+
+	for (std::unique_ptr<Node>& node : nodes)
+	{
+		node->waitingOn.store(node->dependencyCount, std::memory_order_relaxed);
+	}
+	nodesLeft.store(static_cast<unsigned int>(nodes.size()), std::memory_order_release);
+
+	for (NodeId id = 0; id < nodes.size(); ++id)
+	{
+		if (nodes[id]->dependencyCount == 0)
+		{
+			Schedule(id);
+		}
+	}
+
+	pool.Wait(nodesLeft);
+}
+
+void TaskGraph::Schedule(const NodeId id)
+{
+	Node& node = *nodes[id];
+	if (!node.count)
+	{
+		node.tasks[0] = ThreadPool::Task{ &node.function, 0, 1, nullptr };
+		pool.Spawn(node.tasks.data(), 1);
+		return;
+	}
+
+	const unsigned int count = node.count();
+	if (count == 0)
+	{
+		Complete(id);
+		return;
+	}
+
+	const unsigned int chunk = pool.ChunkSize(count, node.grainSize);
+	const unsigned int taskCount = (count + chunk - 1) / chunk;
+	node.chunksLeft.store(taskCount, std::memory_order_relaxed);
+	for (unsigned int i = 0; i < taskCount; ++i)
+	{
+		const unsigned int begin = i * chunk;
+		node.tasks[i] = ThreadPool::Task{ &node.function, begin, std::min(begin + chunk, count), nullptr };
+	}
+	pool.Spawn(node.tasks.data(), taskCount);
+}
+
+void TaskGraph::Complete(const NodeId id)
+{
+	for (const NodeId dependent : nodes[id]->dependents)
+	{
+		if (nodes[dependent]->waitingOn.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			Schedule(dependent);
+		}
+	}
+
+	nodesLeft.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "ThreadPool.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Graph of tasks run on a thread pool. Each node counts the nodes it still waits on, and is queued by
+/// whichever thread finishes its last dependency, so there is no barrier between stages beyond the edges.
+/// The graph is built once and can be run any number of times
+/// </summary>
+class TaskGraph
+{
+public:
+	using NodeId = unsigned int;
+	using TaskFunction = std::function<void(const unsigned int threadIndex)>;
+	using CountFunction = std::function<unsigned int()>;
+
+	TaskGraph(ThreadPool& pool);
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	/// <summary>
+	/// Adds a node that runs function once
+	/// </summary>
+	NodeId AddTask(const TaskFunction& function);
+
+	/// <summary>
+	/// Adds a node that runs function for every index in [0, count()) split into chunks across the pool,
+	/// count is only called once the node's dependencies have finished
+	/// </summary>
+	NodeId AddParallelTask(const CountFunction& count, const unsigned int grainSize, const ThreadPool::Function& function);
+
+	/// <summary>
+	/// Makes after wait for before to finish
+	/// </summary>
+	void AddDependency(const NodeId before, const NodeId after);
+
+	/// <summary>
+	/// Runs every node and waits for them all, helping run them on the calling thread
+	/// </summary>
+	void Run();
+
+private:
+	struct Node
+	{
+		CountFunction count; // empty for single tasks
+		unsigned int grainSize;
+		ThreadPool::RangeFunction function;
+		std::vector<ThreadPool::Task> tasks; // chunks queued when the node is ready
+
+		std::vector<NodeId> dependents;
+		unsigned int dependencyCount = 0;
+		std::atomic<unsigned int> waitingOn;
+		std::atomic<unsigned int> chunksLeft;
+	};
+
+	ThreadPool& pool;
+	std::vector<std::unique_ptr<Node>> nodes;
+	std::atomic<unsigned int> nodesLeft;
+
+	void Schedule(const NodeId id);
+	void Complete(const NodeId id);
+};
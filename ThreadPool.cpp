@@ -0,0 +1,257 @@
+#include "ThreadPool.h"
+#include "Random.h"
+#include <algorithm>
+
+constexpr unsigned int ThreadPool::maxTasks;
+
+namespace
+{
+	// index of the pool thread running on this thread, the caller of ParallelFor is 0
+	thread_local unsigned int currentThread = 0;
+}
+
+ThreadPool::WorkQueue::WorkQueue() :
+	top(0), bottom(0)
+{
+	for (std::atomic<Task*>& task : tasks)
+	{
+		task.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+bool ThreadPool::WorkQueue::Push(Task* pTask)
+{
+	const long long b = bottom.load(std::memory_order_relaxed);
+	const long long t = top.load(std::memory_order_acquire);
+	if (b - t >= capacity) return false;
+
+	tasks[b & (capacity - 1)].store(pTask, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+ThreadPool::Task* ThreadPool::WorkQueue::Pop()
+{
+	// claim the bottom task before checking whether a thief got there first
+	const long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_seq_cst);
+
+	if (t > b) // empty
+	{
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Task* pTask = tasks[b & (capacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last task, race any thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			pTask = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return pTask;
+}
+
+ThreadPool::Task* ThreadPool::WorkQueue::Steal()
+{
+	long long t = top.load(std::memory_order_seq_cst);
+	const long long b = bottom.load(std::memory_order_seq_cst);
+	if (t >= b) return nullptr;
+
+	Task* pTask = tasks[t & (capacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr; // lost to the owner or another thief
+	}
+	return pTask;
+}
+
+ThreadPool::ThreadPool(const size_t threadCount) :
+	threadCount(1), queuedTasks(0), sleepingThreads(0), shouldTerminate(false)
+{
+	Start(threadCount);
+}
+
+ThreadPool::~ThreadPool()
+{
+	Stop();
+}
+
+void ThreadPool::SetThreadCount(const size_t threadCount)
+{
+	if (std::max<size_t>(threadCount, 1) == this->threadCount) return;
+
+	Stop();
+	Start(threadCount);
+}
+
+void ThreadPool::Start(const size_t threadCount)
+{
+	this->threadCount = static_cast<unsigned int>(std::max<size_t>(threadCount, 1));
+	shouldTerminate = false;
+	queues.reset(new WorkQueue[this->threadCount]);
+
+	threads.resize(this->threadCount - 1);
+	for (unsigned int i = 0; i < threads.size(); ++i)
+	{
+		threads[i] = std::thread(&ThreadPool::WorkerLoop, this, i + 1);
+	}
+}
+
+void ThreadPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleepMutex);
+		shouldTerminate = true;
+	}
+	wakeCondition.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	threads.clear();
+}
+
+void ThreadPool::ParallelFor(const unsigned int count, const unsigned int grainSize, const Function& function)
+{
+	ParallelForRange(count, grainSize, [&function](const unsigned int begin, const unsigned int end, const unsigned int threadIndex) {
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			function(i, threadIndex);
+		}
+	});
+}
+
+void ThreadPool::ParallelForRange(const unsigned int count, const unsigned int grainSize, const RangeFunction& function)
+{
+	if (count == 0) return;
+
+	const unsigned int chunk = ChunkSize(count, grainSize);
+	const unsigned int taskCount = (count + chunk - 1) / chunk;
+
+	// nothing to share, so skip the queues entirely
+	if (taskCount == 1 || threadCount == 1)
+	{
+		function(0, count, currentThread);
+		return;
+	}
+
+	Task tasks[maxTasks];
+	std::atomic<unsigned int> pending(taskCount);
+	for (unsigned int i = 0; i < taskCount; ++i)
+	{
+		const unsigned int begin = i * chunk;
+		tasks[i] = Task{ &function, begin, std::min(begin + chunk, count), &pending };
+	}
+
+	Spawn(tasks, taskCount);
+	Wait(pending);
+}
+
+unsigned int ThreadPool::ChunkSize(const unsigned int count, const unsigned int grainSize) const
+{
+	const unsigned int taskLimit = std::min(threadCount * tasksPerThread, maxTasks);
+	return std::max(std::max(grainSize, 1u), (count + taskLimit - 1) / taskLimit);
+}
+
+void ThreadPool::Spawn(Task* pTasks, const unsigned int taskCount)
+{
+	const unsigned int threadIndex = currentThread;
+	int queued = 0;
+	for (unsigned int i = 0; i < taskCount; ++i)
+	{
+		// run it now if the queue is full
+		if (queues[threadIndex].Push(&pTasks[i]))
+		{
+			++queued;
+		}
+		else
+		{
+			Execute(pTasks[i], threadIndex);
+		}
+	}
+
+	Wake(queued);
+}
+
+void ThreadPool::WorkerLoop(const unsigned int threadIndex)
+{
+	currentThread = threadIndex;
+	while (!shouldTerminate)
+	{
+		if (RunTask(threadIndex)) continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		++sleepingThreads;
+		wakeCondition.wait(lock, [this]() {
+			return queuedTasks > 0 || shouldTerminate;
+			});
+		--sleepingThreads;
+	}
+}
+
+void ThreadPool::Wake(const int taskCount)
+{
+	if (taskCount == 0) return;
+
+	// queued tasks is raised before checking for sleepers, and sleepers are counted before
+	// they check queued tasks, so one of the two always sees the other
+	queuedTasks += taskCount;
+	if (sleepingThreads > 0)
+	{
+		std::lock_guard<std::mutex> guard(sleepMutex);
+		wakeCondition.notify_all();
+	}
+}
+
+void ThreadPool::Wait(const std::atomic<unsigned int>& pending)
+{
+	// help with any queued work rather than blocking
+	const unsigned int threadIndex = currentThread;
+	while (pending.load(std::memory_order_acquire) != 0)
+	{
+		if (!RunTask(threadIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool ThreadPool::RunTask(const unsigned int threadIndex)
+{
+	thread_local Random random(threadIndex + 1);
+
+	Task* pTask = queues[threadIndex].Pop();
+
+	// try every other queue once, starting from a random one
+	const unsigned int start = random.Next() % threadCount;
+	for (unsigned int i = 0; pTask == nullptr && i < threadCount; ++i)
+	{
+		const unsigned int victim = (start + i) % threadCount;
+		if (victim != threadIndex)
+		{
+			pTask = queues[victim].Steal();
+		}
+	}
+
+	if (pTask == nullptr) return false;
+
+	--queuedTasks;
+	Execute(*pTask, threadIndex);
+	return true;
+}
+
+void ThreadPool::Execute(const Task& task, const unsigned int threadIndex)
+{
+	std::atomic<unsigned int>* pPending = task.pPending;
+	(*task.pFunction)(task.begin, task.end, threadIndex);
+	if (pPending != nullptr)
+	{
+		pPending->fetch_sub(1, std::memory_order_release);
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include "LinkedVector.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Work stealing thread pool shared by the whole engine. Every thread owns a queue it pushes and pops at the
+/// bottom of without locks, idle threads steal from the top of a random other queue. The thread that calls
+/// ParallelFor takes part as thread 0, and helps run tasks while it waits for its own to finish
+/// </summary>
+class ThreadPool
+{
+public:
+	// called for each index of a ParallelFor, with the index of the thread running it
+	using Function = std::function<void(const unsigned int index, const unsigned int threadIndex)>;
+
+	// called for each chunk [begin, end) of a ParallelForRange
+	using RangeFunction = std::function<void(const unsigned int begin, const unsigned int end, const unsigned int threadIndex)>;
+
+	/// <summary>
+	/// Creates threadCount - 1 workers, the calling thread makes up the last one
+	/// </summary>
+	ThreadPool(const size_t threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Runs function for every index in [0, count), split into chunks of at least grainSize indices,
+	/// and waits for them all to finish. Only one thread outside of the pool may call this at a time
+	/// </summary>
+	void ParallelFor(const unsigned int count, const unsigned int grainSize, const Function& function);
+
+	/// <summary>
+	/// Same as ParallelFor, but function is called once per chunk so it can keep state across the chunk
+	/// </summary>
+	void ParallelForRange(const unsigned int count, const unsigned int grainSize, const RangeFunction& function);
+
+	/// <summary>
+	/// Runs function(T& element, threadIndex) for every element of every vector in the linked vector,
+	/// chunks can span the boundary between two vectors
+	/// </summary>
+	template<class T, class ElementFunction>
+	void ParallelFor(LinkedVector<T>& container, const unsigned int grainSize, const ElementFunction& function);
+
+	/// <summary>
+	/// Replaces the workers with a new set, must not be called while a ParallelFor is running
+	/// </summary>
+	void SetThreadCount(const size_t threadCount);
+
+	// number of threads including the caller, thread indices passed to functions are below this
+	inline unsigned int ThreadCount() const { return threadCount; }
+
+	// a chunk of work, must outlive its run, pending is decremented once it has run if not null
+	struct Task
+	{
+		const RangeFunction* pFunction;
+		unsigned int begin;
+		unsigned int end;
+		std::atomic<unsigned int>* pPending;
+	};
+
+	static constexpr unsigned int maxTasks = 256; // most tasks a single ParallelFor splits into
+
+	/// <summary>
+	/// Size of the chunks a range of count indices is split into, so there are at most maxTasks of them
+	/// </summary>
+	unsigned int ChunkSize(const unsigned int count, const unsigned int grainSize) const;
+
+	/// <summary>
+	/// Queues tasks on the calling thread's queue without waiting for them
+	/// </summary>
+	void Spawn(Task* pTasks, const unsigned int taskCount);
+
+	/// <summary>
+	/// Runs queued tasks until pending reaches zero
+	/// </summary>
+	void Wait(const std::atomic<unsigned int>& pending);
+
+private:
+	/// <summary>
+	/// Fixed size Chase-Lev deque, only the owning thread may push and pop
+	/// </summary>
+	class WorkQueue
+	{
+	public:
+		static constexpr long long capacity = 1024;
+
+		WorkQueue();
+
+		// false if the queue is full
+		bool Push(Task* pTask);
+		Task* Pop();
+		Task* Steal();
+
+	private:
+		std::atomic<long long> top;
+		char padding[64]; // keep thieves and the owner off each other's cache line
+		std::atomic<long long> bottom;
+		std::atomic<Task*> tasks[capacity];
+	};
+
+	static constexpr unsigned int tasksPerThread = 4; // a few chunks per thread so uneven chunks still balance
+
+	unsigned int threadCount;
+	std::vector<std::thread> threads;
+	std::unique_ptr<WorkQueue[]> queues;
+
+	// idle workers sleep until tasks are queued
+	std::atomic<int> queuedTasks;
+	std::atomic<unsigned int> sleepingThreads;
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<bool> shouldTerminate;
+
+	void Start(const size_t threadCount);
+	void Stop();
+
+	void WorkerLoop(const unsigned int threadIndex);
+	void Wake(const int taskCount);
+
+	/// <summary>
+	/// Pops a task from the thread's own queue, or steals one, and runs it
+	/// </summary>
+	/// <returns>false if no task was found</returns>
+	bool RunTask(const unsigned int threadIndex);
+	static void Execute(const Task& task, const unsigned int threadIndex);
+};
+
+template<class T, class ElementFunction>
+void ThreadPool::ParallelFor(LinkedVector<T>& container, const unsigned int grainSize, const ElementFunction& function)
+{
+	// first index of each vector in the chain, so a chunk can find where it starts
+	std::vector<LinkedVector<T>*> vectors;
+	std::vector<unsigned int> offsets;
+	unsigned int count = 0;
+	for (LinkedVector<T>* pVector = &container; pVector != nullptr; pVector = pVector->Next())
+	{
+		vectors.push_back(pVector);
+		offsets.push_back(count);
+		count += static_cast<unsigned int>(pVector->vector.size());
+	}
+
+	ParallelForRange(count, grainSize, [&](const unsigned int begin, const unsigned int end, const unsigned int threadIndex) {
+		size_t v = (std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin()) - 1;
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			while (i - offsets[v] >= vectors[v]->vector.size()) ++v; // skips empty vectors too
+			function(vectors[v]->vector[i - offsets[v]], threadIndex);
+		}
+	});
+}
@@ -1,5 +1,7 @@
 #include "TimeLogger.h"
 #include "globals.h"
+#include "PhysicsKernels.h"
+#include <algorithm>
 #include <array>
 #include <ctime>
 #include <fstream>
@@ -12,6 +14,16 @@ namespace TimeLogger
 		unsigned int deltaTimeIndex = 0;
 		std::array<float, 50> deltaTimeArray;
         std::ofstream* outStream = nullptr;
+
+        // summed over the same physics steps as deltaTimeArray
+        size_t candidatePairSum = 0;
+        size_t contactSum = 0;
+        size_t sleepingSum = 0;
+        size_t stepCount = 0;
+
+        // indexed by OctreeLayout
+        const char* const layoutNames[] = { "full", "adaptive", "sparse", "linear" };
+        const char* const broadphaseNames[] = { "octree", "uniform grid", "sweep and prune", "aabb tree" };
 	}
 
     tm GetTimeInfo()
@@ -51,7 +63,33 @@ namespace TimeLogger
     {
         if (outStream == nullptr) return;
         *outStream << "Initialisation took (in milliseconds): " << initTime << std::endl;
-        *outStream << "Octree Depth: " << octreeDepth << ". Thread count: " << threadCount << std::endl;
+        if (broadphaseType != BroadphaseType::Octree)
+        {
+            *outStream << "Broadphase: " << broadphaseNames[static_cast<unsigned int>(broadphaseType)] << ". Thread count: " << threadCount << std::endl;
+        }
+        else
+        {
+            *outStream << "Octree Depth: " << octreeDepth << ", layout: " << layoutNames[static_cast<unsigned int>(octreeLayout)] << ", looseness: " << octreeLooseness << ". Thread count: " << threadCount << std::endl;
+        }
+        *outStream << "Physics rate (steps per second): " << physicsRate << std::endl;
+        if (substeps == 0)
+        {
+            *outStream << "Timestep: variable" << std::endl;
+        }
+        else
+        {
+            *outStream << "Timestep: fixed, " << fixedDeltaTime << "s in " << substeps << " substeps" << std::endl;
+        }
+        *outStream << "Integration kernel: " << PhysicsKernels::GetInstructionSetName() << std::endl;
+        *outStream << "Seed: " << randomSeed << (deterministic ? " (deterministic)" : "") << std::endl;
+    }
+
+    void UpdatePairs(const size_t candidatePairs, const size_t contacts, const size_t sleeping)
+    {
+        candidatePairSum += candidatePairs;
+        contactSum += contacts;
+        sleepingSum += sleeping;
+        ++stepCount;
     }
 
     void Update(const float deltaTime)
@@ -60,6 +98,15 @@ namespace TimeLogger
         if (deltaTimeIndex == deltaTimeArray.size())
         {
             deltaTimeIndex = 0;
+
+            const float steps = (float)std::max<size_t>(stepCount, 1);
+            const float averagePairs = candidatePairSum / steps;
+            const float averageContacts = contactSum / steps;
+            const float averageSleeping = sleepingSum / steps;
+            candidatePairSum = 0;
+            contactSum = 0;
+            sleepingSum = 0;
+            stepCount = 0;
             if (outStream == nullptr) return;
 
             float sum = 0;
@@ -70,7 +117,10 @@ namespace TimeLogger
             sum /= deltaTimeArray.size();
 
             *outStream << "\nCounts - Cube: " << boxCount << ", Sphere:" << sphereCount << ", Total: " << boxCount + sphereCount << std::endl;
-            *outStream << "Average time (in seconds) taken to update physics over last " << deltaTimeArray.size() << " frames: " << sum << std::endl;
+            *outStream << "Average time (in seconds) taken to update physics over last " << deltaTimeArray.size() << " steps: " << sum << std::endl;
+            *outStream << "Average " << broadphaseNames[static_cast<unsigned int>(broadphaseType)] << " broadphase pairs: " << averagePairs << ", contacts: " << averageContacts
+                << ", efficiency: " << (averagePairs != 0.0f ? averageContacts / averagePairs : 0.0f) << std::endl;
+            *outStream << "Average sleeping bodies: " << averageSleeping << std::endl;
         }
 	}
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 namespace TimeLogger
 {
@@ -6,4 +7,5 @@ namespace TimeLogger
 	void Destroy();
 	void LogInit(const float initTime);
 	void Update(const float deltaTime);
+	void UpdatePairs(const size_t candidatePairs, const size_t contacts, const size_t sleeping);
 }
\ No newline at end of file
@@ -3,9 +3,9 @@
 
 #define TRACKERS \
 TI(Default), \
-TI(Box), \
-TI(Sphere), \
-TI(Octant)
+TI(Collider), \
+TI(Octant), \
+TI(AabbNode)
 
 namespace MemoryManager
 {
@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+
+/// <summary>
+/// Lock free triple buffer for one writer and one reader. The writer fills its own buffer and publishes it
+/// by swapping it with the shared middle buffer, the reader swaps the middle buffer with its own when a
+/// newer one has been published. Neither side ever waits, and the reader always sees a whole buffer
+/// </summary>
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : middle(1), writeIndex(0), readIndex(2) {}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	/// <summary>
+	/// Buffer owned by the writer, only valid until the next Publish
+	/// </summary>
+	inline T& Write() noexcept
+	{
+		return buffers[writeIndex];
+	}
+
+	/// <summary>
+	/// Makes the write buffer the newest one the reader can take
+	/// </summary>
+	inline void Publish() noexcept
+	{
+		writeIndex = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	/// <summary>
+	/// Newest published buffer, stays the same until the next call to Read
+	/// </summary>
+	inline const T& Read() noexcept
+	{
+		if (middle.load(std::memory_order_relaxed) & freshBit)
+		{
+			readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+		}
+		return buffers[readIndex];
+	}
+
+private:
+	static constexpr unsigned int indexMask = 3;
+	static constexpr unsigned int freshBit = 4; // set in middle when it holds a buffer the reader hasn't taken
+
+	T buffers[3];
+	std::atomic<unsigned int> middle;
+	unsigned int writeIndex; // only touched by the writer
+	unsigned int readIndex; // only touched by the reader
+};
@@ -12,8 +12,53 @@ extern unsigned int boxCount;
 extern unsigned int sphereCount;
 extern size_t threadCount;
 extern unsigned int octreeDepth;
+extern float octreeLooseness; // 1 for a tight octree, above 1 grows every octant's bounds by this factor
+
+// how the octree's octants are made, none of them go deeper than octreeDepth
+enum class OctreeLayout : unsigned int
+{
+	Full, // every octant is built up front
+	Adaptive, // octants split when crowded and merge when nearly empty
+	Sparse, // octants only exist on the way to a body, and are found by locational code rather than by descending
+	Linear // no octants, bodies are radix sorted by the Morton code of their octant every frame
+};
+extern OctreeLayout octreeLayout;
+
+// what finds the candidate pairs each step
+enum class BroadphaseType : unsigned int
+{
+	Octree, // any of the octree layouts above
+	HashGrid, // a uniform grid of cells as wide as the largest body
+	SweepAndPrune, // bodies kept sorted along one axis from step to step
+	AabbTree // a balanced tree of bounds around bodies, fitting any world size
+};
+extern BroadphaseType broadphaseType;
+
+// deterministic mode gives bit identical runs for the same seed whatever the thread count
+extern bool deterministic;
+extern unsigned int randomSeed;
+
+// steps per second of the physics thread, independent of the render rate
+constexpr float physicsRate = 240.0f;
+
+// length of one fixed step, time is banked in an accumulator and spent in steps of this size
+constexpr float fixedDeltaTime = 1.0f / physicsRate;
+
+// each fixed step is split into this many substeps, 0 steps by the raw frame time instead
+extern unsigned int substeps;
+
+// most fixed steps taken in one tick, time beyond this is dropped rather than caught up on
+constexpr unsigned int maxCatchUpSteps = 4;
+
+// bodies slower than sleepVelocity for timeToSleep seconds are put to sleep, along with
+// everything they touch once all of that has been resting as long
+extern bool sleepEnabled;
+constexpr float sleepVelocity = 0.5f;
+constexpr float timeToSleep = 0.5f;
 
 constexpr unsigned int maxOctantDepth = 10;
+constexpr unsigned int maxSparseOctantDepth = 21; // a locational code is a 1 then 3 bits per level in 64 bits
+constexpr unsigned int maxLinearOctantDepth = 19; // a sort key is 3 bits per level then 5 bits of level in 64 bits
 
 constexpr size_t chunkSize = 100;
 constexpr size_t chunkCount = 10;
@@ -1,12 +1,16 @@
 #include <GL/freeglut.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include "globals.h"
 #include "Vec3.h"
 #include "ColliderObject.h"
-#include "Box.h"
-#include "Sphere.h"
+#include "ColliderStore.h"
 
 #include "MemoryOperators.h"
 #include "MemoryManager.h"
@@ -15,21 +19,74 @@
 
 #include "Timer.h"
 #include "TimeLogger.h"
-#include "LinkedVector.h"
 #include "Octree.h"
+#include "HashGridBroadphase.h"
+#include "SweepAndPrune.h"
+#include "DynamicAabbTree.h"
+#include "NarrowPhase.h"
+#include "ContactSolver.h"
+#include "Islands.h"
+#include "PhysicsKernels.h"
+#include "ThreadPool.h"
+#include "TaskGraph.h"
+#include "TripleBuffer.h"
 
 using namespace std::chrono;
-using ColliderObjs = LinkedVector<ColliderObject*>;
 
-ColliderObjs* sphereColliders = nullptr;
-ColliderObjs* boxColliders = nullptr;
+ColliderStore* colliders = nullptr;
 
 unsigned int boxCount = 0;
 unsigned int sphereCount = 0;
 size_t threadCount = 4;
 unsigned int octreeDepth = 4;
-
-Octree* octree = nullptr;
+float octreeLooseness = 1.0f;
+OctreeLayout octreeLayout = OctreeLayout::Full;
+BroadphaseType broadphaseType = BroadphaseType::Octree;
+bool deterministic = false;
+unsigned int randomSeed = 0;
+unsigned int substeps = 1;
+bool sleepEnabled = true;
+unsigned long long physicsFrame = 0;
+
+ThreadPool* threadPool = nullptr;
+Broadphase* broadphase = nullptr; // of broadphaseType, can be swapped between steps
+
+std::vector<CollisionPair> contacts;
+ContactSolver contactSolver;
+Islands islands;
+std::vector<unsigned int> largeIslands; // islands split into coloured batches rather than solved as one task
+unsigned int sleepingCount = 0;
+
+// the physics step as a graph of tasks, rebuilt when the bin count changes
+TaskGraph* frameGraph = nullptr;
+unsigned int frameGraphBins = 0;
+float frameDeltaTime = 0.0f;
+std::vector<std::vector<CollisionPair>> threadContacts;
+std::vector<size_t> threadCandidateCounts;
+size_t candidateCount = 0;
+
+// what the render thread draws, with the positions from the start of the tick so it can
+// interpolate between the last two states rather than jumping once per tick
+struct RenderSnapshot {
+    ColliderStore bodies;
+    std::vector<float> previousX;
+    std::vector<float> previousY;
+    std::vector<float> previousZ;
+    steady_clock::time_point time; // when it was published
+    float stepLength = 0.0f; // simulated seconds between the previous and current positions
+};
+
+// physics runs on its own thread, the render thread only sees the snapshots it publishes
+std::thread physicsThread;
+std::atomic<bool> physicsRunning(false);
+TripleBuffer<RenderSnapshot>* renderSnapshots = nullptr;
+bool publishFrame = true; // only the last step of a tick publishes
+float tickLength = 0.0f; // simulated time stepped so far this tick
+bool interpolateRendering = true; // only touched by the render thread
+
+// input is queued and run on the physics thread between steps, as that thread owns the store
+std::mutex commandMutex;
+std::vector<std::function<void()>> commands;
 
 // used in the 'mouse' tap function to convert a screen point to a point in the world
 Vec3 screenToWorld(int x, int y) {
@@ -52,18 +109,252 @@ Vec3 screenToWorld(int x, int y) {
     return Vec3((float)posX, (float)posY, (float)posZ);
 }
 
+// keeps the positions at the start of a tick in the snapshot that will be published at its end
+void recordPreviousPositions() {
+    RenderSnapshot& snapshot = renderSnapshots->Write();
+    const ColliderStore& store = *colliders;
+    snapshot.previousX.assign(store.positionX, store.positionX + store.Count());
+    snapshot.previousY.assign(store.positionY, store.positionY + store.Count());
+    snapshot.previousZ.assign(store.positionZ, store.positionZ + store.Count());
+}
+
+// copies what drawing needs out of the store and hands it to the render thread
+void publishSnapshot() {
+    RenderSnapshot& snapshot = renderSnapshots->Write();
+    snapshot.bodies.CopyDrawState(*colliders);
+    snapshot.time = steady_clock::now();
+    snapshot.stepLength = tickLength;
+    renderSnapshots->Publish();
+}
+
+// makes a broadphase of broadphaseType for the store and pool
+Broadphase* createBroadphase() {
+    switch (broadphaseType) {
+    case BroadphaseType::HashGrid:
+        return new HashGridBroadphase(*threadPool, *colliders, Vec3(minX, minY, minZ), Vec3(maxX, maxY, maxZ));
+    case BroadphaseType::SweepAndPrune:
+        return new SweepAndPrune(*threadPool, *colliders);
+    case BroadphaseType::AabbTree:
+        return new DynamicAabbTree(*threadPool, *colliders);
+    default:
+        return new Octree(
+            *threadPool,
+            *colliders,
+            Vec3((maxX - minX) / 2.0f, (maxY - minY) / 2.0f, (maxZ - minZ) / 2.0f),
+            Vec3(maxX - minX, maxZ - minZ, maxZ - minZ),
+            octreeDepth,
+            octreeLooseness,
+            octreeLayout
+        );
+    }
+}
+
+// builds the graph for one physics step:
+// integrate bin -> count bin -> prefix sum -> scatter bins -> gather regions -> collide regions -> islands
+//     -> solve small islands + solve large islands -> snapshot
+// each bin is counted as soon as its own bodies are integrated, and the narrow phase runs
+// inside each region's task so contacts are ready as soon as the last region finishes
+// regions are octants for the octree, occupied cells for the grid, slices of the pair set for
+// sweep and prune and slices of bodies for the aabb tree. The broadphase adapts itself to this
+// step's bodies alongside the islands
+void buildFrameGraph() {
+    delete frameGraph;
+    frameGraph = new TaskGraph(*threadPool);
+    frameGraphBins = broadphase->BinCount();
+    threadContacts.resize(frameGraphBins);
+    threadCandidateCounts.resize(frameGraphBins);
+
+    const TaskGraph::NodeId prefixSum = frameGraph->AddTask([](const unsigned int) {
+        broadphase->PrefixSum();
+    });
+
+    for (unsigned int bin = 0; bin < frameGraphBins; ++bin) {
+        // bins start on batch boundaries so the SIMD kernel never splits a batch, trailing bins
+        // can be empty and start at the body count, which isn't a boundary, so they are skipped
+        const TaskGraph::NodeId integrate = frameGraph->AddTask([bin](const unsigned int) {
+            if (broadphase->BinBegin(bin) >= broadphase->BinEnd(bin)) return;
+            PhysicsKernels::Integrate(*colliders, broadphase->BinBegin(bin), broadphase->BinEnd(bin), frameDeltaTime);
+        });
+        const TaskGraph::NodeId count = frameGraph->AddTask([bin](const unsigned int) {
+            broadphase->CountBin(bin);
+        });
+        frameGraph->AddDependency(integrate, count);
+        frameGraph->AddDependency(count, prefixSum);
+    }
+
+    const TaskGraph::NodeId scatter = frameGraph->AddParallelTask([]() { return broadphase->BinCount(); }, 1,
+        [](const unsigned int bin, const unsigned int) {
+            broadphase->ScatterBin(bin);
+        });
+    frameGraph->AddDependency(prefixSum, scatter);
+
+    // region tasks can only start once every body is in place
+    const TaskGraph::NodeId gather = frameGraph->AddTask([](const unsigned int) {
+        broadphase->GatherRegions();
+        for (unsigned int i = 0; i < threadContacts.size(); ++i) {
+            threadContacts[i].clear();
+            threadCandidateCounts[i] = 0;
+        }
+    });
+    frameGraph->AddDependency(scatter, gather);
+
+    const TaskGraph::NodeId collide = frameGraph->AddParallelTask([]() { return broadphase->RegionCount(); }, 1,
+        [](const unsigned int index, const unsigned int threadIndex) {
+            thread_local std::vector<CollisionPair> candidates;
+            candidates.clear();
+            broadphase->FindRegionPairs(index, candidates);
+            threadCandidateCounts[threadIndex] += candidates.size();
+            NarrowPhase::Filter(*colliders, candidates, threadContacts[threadIndex]);
+        });
+    frameGraph->AddDependency(gather, collide);
+
+    // nothing reads the broadphase again this step once the pairs are found
+    const TaskGraph::NodeId adapt = frameGraph->AddTask([](const unsigned int) {
+        broadphase->Adapt();
+    });
+    frameGraph->AddDependency(collide, adapt);
+
+    // islands need every contact, so building them is the one remaining barrier
+    const TaskGraph::NodeId findIslands = frameGraph->AddTask([](const unsigned int) {
+        contacts.clear();
+        candidateCount = 0;
+        for (unsigned int i = 0; i < threadContacts.size(); ++i) {
+            contacts.insert(contacts.end(), threadContacts[i].begin(), threadContacts[i].end());
+            candidateCount += threadCandidateCounts[i];
+        }
+        if (deterministic) {
+            NarrowPhase::SortPairs(contacts);
+        }
+
+        islands.Build(*colliders, contacts);
+        largeIslands.clear();
+        for (unsigned int island = 0; island < islands.Count(); ++island) {
+            if (islands.ContactCount(island) >= ContactSolver::splitThreshold) {
+                largeIslands.push_back(island);
+            }
+        }
+    });
+    frameGraph->AddDependency(collide, findIslands);
+
+    // no contact joins two islands, so each island is solved and put to sleep without locks,
+    // islands that have come to rest stop being integrated and binned from the next step
+    const TaskGraph::NodeId solveSmall = frameGraph->AddParallelTask([]() { return islands.Count(); }, 1,
+        [](const unsigned int island, const unsigned int) {
+            if (islands.ContactCount(island) >= ContactSolver::splitThreshold) return;
+
+            ContactSolver::SolveSerial(*colliders, islands.Contacts(island), islands.ContactCount(island));
+            if (sleepEnabled) {
+                islands.UpdateSleep(*colliders, island, frameDeltaTime);
+            }
+        });
+    frameGraph->AddDependency(findIslands, solveSmall);
+
+    // large islands would hold up the rest of the step as one task, so they are split into coloured
+    // batches instead, spread across the pool while the small islands are solved
+    const TaskGraph::NodeId solveLarge = frameGraph->AddTask([](const unsigned int) {
+        for (const unsigned int island : largeIslands) {
+            contactSolver.Solve(*colliders, islands.Contacts(island), islands.ContactCount(island), *threadPool);
+            if (sleepEnabled) {
+                islands.UpdateSleep(*colliders, island, frameDeltaTime);
+            }
+        }
+    });
+    frameGraph->AddDependency(findIslands, solveLarge);
+
+    const TaskGraph::NodeId snapshot = frameGraph->AddTask([](const unsigned int) {
+        const ColliderStore& store = *colliders;
+        sleepingCount = static_cast<unsigned int>(std::count(store.asleep, store.asleep + store.Count(), 1));
+        if (publishFrame) {
+            publishSnapshot();
+        }
+    });
+    frameGraph->AddDependency(solveSmall, snapshot);
+    frameGraph->AddDependency(solveLarge, snapshot);
+}
+
 // update the physics: gravity, collision test, collision resolution
 void updatePhysics(const float deltaTime) {
-    octree->ClearLists();
+    broadphase->BeginBuild();
+    if (frameGraph == nullptr || frameGraphBins != broadphase->BinCount()) {
+        buildFrameGraph();
+    }
+
+    frameDeltaTime = deltaTime;
+    tickLength += deltaTime;
+    frameGraph->Run();
+
+    TimeLogger::UpdatePairs(candidateCount, contacts.size(), sleepingCount);
+    ++physicsFrame;
+}
+
+// queues a command to run on the physics thread before its next step
+void postCommand(const std::function<void()>& command) {
+    std::lock_guard<std::mutex> guard(commandMutex);
+    commands.push_back(command);
+}
+
+void runCommands() {
+    thread_local std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> guard(commandMutex);
+        pending.swap(commands);
+    }
+
+    for (const std::function<void()>& command : pending) {
+        command();
+    }
+    pending.clear();
+}
+
+// works out how many steps of what length to take for frameTime seconds of wall clock
+// a variable timestep takes one step of the whole frame, a fixed one banks the time and takes
+// as many whole fixed steps as it covers, capped so a slow frame can't snowball into longer ones
+unsigned int planSteps(const float frameTime, float& accumulator, float& stepLength) {
+    if (substeps == 0) {
+        stepLength = frameTime;
+        return 1;
+    }
+
+    accumulator = std::min(accumulator + frameTime, fixedDeltaTime * maxCatchUpSteps);
+    const unsigned int fixedSteps = static_cast<unsigned int>(accumulator / fixedDeltaTime);
+    accumulator -= fixedSteps * fixedDeltaTime;
 
-    ColliderObjs& colliders = *boxColliders;
-    for (ColliderObject* box : colliders) { 
-        if (box == nullptr) continue;
+    stepLength = fixedDeltaTime / substeps;
+    return fixedSteps * substeps;
+}
 
-        box->update(deltaTime);
-        octree->Insert(box);
+// steps the physics at physicsRate, or as fast as it can if a step takes longer
+void physicsLoop() {
+    const steady_clock::duration tickTime = duration_cast<steady_clock::duration>(duration<float>(1.0f / physicsRate));
+    auto last = steady_clock::now();
+    auto nextTick = last;
+    float accumulator = 0.0f;
+
+    while (physicsRunning) {
+        runCommands();
+
+        const auto now = steady_clock::now();
+        const duration<float> frameTime = now - last;
+        last = now;
+
+        float stepLength = 0.0f;
+        const unsigned int stepCount = planSteps(frameTime.count(), accumulator, stepLength);
+        if (stepCount != 0) {
+            recordPreviousPositions();
+            tickLength = 0.0f;
+            for (unsigned int step = 0; step < stepCount; ++step) {
+                // each step is logged on its own, a tick can cover several fixed steps
+                const auto stepStart = steady_clock::now();
+                publishFrame = step + 1 == stepCount;
+                updatePhysics(stepLength);
+                const duration<float> updatePhysTime = steady_clock::now() - stepStart;
+                TimeLogger::Update(updatePhysTime.count());
+            }
+        }
+
+        nextTick = std::max(nextTick + tickTime, steady_clock::now());
+        std::this_thread::sleep_until(nextTick);
     }
-    octree->TestCollisions();
 }
 
 // draw the sides of the containing area
@@ -106,10 +397,24 @@ void drawScene() {
     Vec3 backWallV4(maxX, minY, minZ);
     drawQuad(backWallV1, backWallV2, backWallV3, backWallV4);
 
-    ColliderObjs& colliders = *boxColliders;
-    for (ColliderObject* box : colliders) {
-        if (box == nullptr) continue;
-        box->draw();
+    const RenderSnapshot& snapshot = renderSnapshots->Read();
+    const ColliderStore& store = snapshot.bodies;
+    if (!interpolateRendering || snapshot.stepLength <= 0.0f) {
+        for (unsigned int id = 0; id < store.Count(); ++id) {
+            ColliderObject::draw(store, id);
+        }
+        return;
+    }
+
+    // drawn one tick behind, moving from the previous positions to the current ones over the tick
+    const duration<float> sincePublish = steady_clock::now() - snapshot.time;
+    const float alpha = std::min(sincePublish.count() / snapshot.stepLength, 1.0f);
+    for (unsigned int id = 0; id < store.Count(); ++id) {
+        const Vec3 position(
+            snapshot.previousX[id] + (store.positionX[id] - snapshot.previousX[id]) * alpha,
+            snapshot.previousY[id] + (store.positionY[id] - snapshot.previousY[id]) * alpha,
+            snapshot.previousZ[id] + (store.positionZ[id] - snapshot.previousZ[id]) * alpha);
+        ColliderObject::draw(store, id, position);
     }
 }
 
@@ -125,21 +430,10 @@ void display() {
     glutSwapBuffers();
 }
 
-// called by GLUT when the cpu is idle - has a timer function you can use for FPS, and updates the physics
+// called by GLUT when the cpu is idle, physics runs on its own thread so this only asks for a redraw
 // see https://www.opengl.org/resources/libraries/glut/spec3/node63.html#:~:text=glutIdleFunc
-// NOTE this may be capped at 60 fps as we are using glutPostRedisplay(). If you want it to go higher than this, maybe a thread will help here. 
+// NOTE this may be capped at 60 fps as we are using glutPostRedisplay(), which no longer limits the physics rate
 void idle() {
-    static auto last = steady_clock::now();
-    const duration<float> frameTime = steady_clock::now() - last;
-    float deltaTime = frameTime.count();
-    last = steady_clock::now();
-
-
-    updatePhysics(deltaTime);
-    const duration<float> updatePhysTime = steady_clock::now() - last;
-    TimeLogger::Update(updatePhysTime.count());
-
-    // tell glut to draw - note this will cap this function at 60 fps
     glutPostRedisplay();
 }
 
@@ -157,70 +451,82 @@ void mouse(int button, int state, int x, int y) {
         Vec3 rayDirection = clickedWorldPos - cameraPosition;
         rayDirection.normalise();
 
-        // Perform a ray-box intersection test and remove the clicked box
-        float minIntersectionDistance = std::numeric_limits<float>::max();
+        // Perform a ray-box intersection test and remove the clicked box, on the physics thread as it owns the store
+        postCommand([cameraPosition, rayDirection]() {
+            float minIntersectionDistance = std::numeric_limits<float>::max();
 
-        ColliderObject* clickedBox = nullptr;
-        ColliderObjs& colliders = *boxColliders;
-        for (ColliderObject* box : colliders) {
+            unsigned int clickedBox = ColliderStore::nullId;
+            ColliderStore& store = *colliders;
 
-            if (box->rayBoxIntersection(cameraPosition, rayDirection)) {
-                // Calculate the distance between the camera and the intersected box
-                Vec3 diff = box->position - cameraPosition;
-                float distance = diff.length();
+            // only the bodies whose bounds the ray passes through can be hit
+            std::vector<unsigned int> candidates;
+            broadphase->QueryRay(cameraPosition, rayDirection, candidates);
+            for (const unsigned int id : candidates) {
 
-                // Update the clicked box index if this box is closer to the camera
-                if (distance < minIntersectionDistance) {
-                    minIntersectionDistance = distance;
-                    clickedBox = box;
+                if (ColliderObject::rayBoxIntersection(store, id, cameraPosition, rayDirection)) {
+                    // Calculate the distance between the camera and the intersected box
+                    Vec3 diff = store.Position(id) - cameraPosition;
+                    float distance = diff.length();
+
+                    // Update the clicked box index if this box is closer to the camera
+                    if (distance < minIntersectionDistance) {
+                        minIntersectionDistance = distance;
+                        clickedBox = id;
+                    }
                 }
             }
-        }
 
-        if (clickedBox != nullptr)
-        {
-            auto end = colliders.end();
-            auto it = std::find(colliders.begin(), end, clickedBox);
-            if (it != end)
+            if (clickedBox != ColliderStore::nullId)
             {
-                if (clickedBox->isBox)
+                if (store.type[clickedBox] == ColliderType::Box)
                     --boxCount;
                 else
                     --sphereCount;
 
-
-
-                std::vector<ColliderObject*>& owningVector = it.linkedVec->vector;
-                size_t offset = (it.getPtr() - owningVector.data());
-                delete clickedBox;
-                owningVector.erase(owningVector.begin() + offset);
-
+                store.Remove(clickedBox);
             }
-        }
+        });
     }
 }
 
 void cleanup()
 {
-    if (sphereColliders != nullptr && boxColliders != nullptr)
+    // stop stepping before anything the step uses goes away
+    physicsRunning = false;
+    if (physicsThread.joinable())
     {
-        ColliderObjs& colliders = *boxColliders;
-        for (auto it = colliders.begin(); it != colliders.end(); ++it) {
-            delete* it;
-            *it = nullptr;
-        }
-        colliders.clear();
+        physicsThread.join();
+    }
+
+    // the graph runs on the pool and the broadphase refers to the store and the pool, so they go first
+    if (frameGraph != nullptr)
+    {
+        delete frameGraph;
+        frameGraph = nullptr;
+    }
+
+    if (broadphase != nullptr)
+    {
+        delete broadphase;
+        broadphase = nullptr;
+    }
 
-        delete sphereColliders;
-        sphereColliders = nullptr;
-        delete boxColliders;
-        boxColliders = nullptr;
+    if (threadPool != nullptr)
+    {
+        delete threadPool;
+        threadPool = nullptr;
     }
 
-    if (octree != nullptr)
+    if (colliders != nullptr)
     {
-        delete octree;
-        octree = nullptr;
+        delete colliders;
+        colliders = nullptr;
+    }
+
+    if (renderSnapshots != nullptr)
+    {
+        delete renderSnapshots;
+        renderSnapshots = nullptr;
     }
 
     TimeLogger::Destroy();
@@ -232,19 +538,62 @@ void cleanup()
     MemoryPoolManager::Cleanup();
 }
 
-// called when the keyboard is used
-void keyboard(unsigned char key, int x, int y) {
-    const float impulseMagnitude = 20.0f; // Upward impulse magnitude
+// removes the most recently added collider of the given type, false if there are none
+bool removeLastCollider(const ColliderType type)
+{
+    ColliderStore& store = *colliders;
+    for (unsigned int id = store.Count(); id != 0; --id) {
+        if (store.type[id - 1] == type) {
+            store.Remove(id - 1);
+            return true;
+        }
+    }
+    return false;
+}
 
-    static int* intPtr = nullptr;
+// runs the broadphase outside of the frame graph and checks it against its own bounds queries,
+// every pair of overlapping bodies that aren't both asleep has to be a candidate
+void checkBroadphase() {
+    std::vector<CollisionPair> pairs;
+    broadphase->Update(pairs);
+
+    std::vector<uint64_t> keys;
+    keys.reserve(pairs.size());
+    for (const CollisionPair& pair : pairs) {
+        keys.push_back(static_cast<uint64_t>(std::min(pair.a, pair.b)) << 32 | std::max(pair.a, pair.b));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    const ColliderStore& store = *colliders;
+    size_t missed = 0;
+    std::vector<unsigned int> overlapping;
+    for (unsigned int id = 0; id < store.Count(); ++id) {
+        overlapping.clear();
+        broadphase->QueryBounds(PhysicsKernels::Bounds::FromStore(store, id), overlapping);
+        for (const unsigned int other : overlapping) {
+            if (other <= id || (store.asleep[id] && store.asleep[other])) continue;
+
+            const uint64_t key = static_cast<uint64_t>(id) << 32 | other;
+            if (!std::binary_search(keys.begin(), keys.end(), key)) {
+                ++missed;
+            }
+        }
+    }
+    std::cout << "Broadphase " << broadphase->Name() << ": " << pairs.size() << " candidate pairs, " << missed << " missed" << std::endl;
+}
+
+// keys that change the simulation, run on the physics thread between steps
+void simulationKey(unsigned char key) {
+    const float impulseMagnitude = 20.0f; // Upward impulse magnitude
 
     switch (key)
     {
     case ' ': // make colliders jump
     {
-        ColliderObjs& colliders = *boxColliders;
-        for (ColliderObject* box : colliders) {
-            box->velocity.y += impulseMagnitude;
+        ColliderStore& store = *colliders;
+        store.WakeAll();
+        for (unsigned int id = 0; id < store.Count(); ++id) {
+            store.velocityY[id] += impulseMagnitude;
         }
     }
         break;
@@ -258,6 +607,72 @@ void keyboard(unsigned char key, int x, int y) {
         MemoryManager::WalkHeap();
         break;
 #endif
+    case 'v': // check the broadphase finds every overlapping pair
+        checkBroadphase();
+        break;
+    case 'c': // print a hash of the simulation state, to compare deterministic runs
+        std::cout << "Frame " << physicsFrame << " state hash: " << std::hex << colliders->Hash() << std::dec << std::endl;
+        break;
+    case 'r':
+        if (removeLastCollider(ColliderType::Box))
+        {
+            std::cout << "Removed Box" << std::endl;
+            if (boxCount != 0) --boxCount;
+        }
+        break;
+    case 'a':
+        ColliderObject::createCollider(*colliders, ColliderType::Box);
+        std::cout << "Added Box" << std::endl;
+        ++boxCount;
+        break;
+    case 'R':
+        if (removeLastCollider(ColliderType::Sphere))
+        {
+            std::cout << "Removed Sphere" << std::endl;
+            if (sphereCount != 0) --sphereCount;
+        }
+        break;
+    case 'A':
+        ColliderObject::createCollider(*colliders, ColliderType::Sphere);
+        std::cout << "Added Sphere" << std::endl;
+        ++sphereCount;
+        break;
+    case 'z': // toggle putting resting bodies to sleep
+        sleepEnabled = !sleepEnabled;
+        if (!sleepEnabled) {
+            colliders->WakeAll();
+        }
+        std::cout << "Sleeping " << (sleepEnabled ? "on" : "off") << std::endl;
+        break;
+    case '+': // change the thread count, physics isn't mid step here so the pool is idle
+        threadPool->SetThreadCount(++threadCount);
+        std::cout << "Thread count: " << threadCount << std::endl;
+        break;
+    case '-':
+        if (threadCount > 1)
+        {
+            threadPool->SetThreadCount(--threadCount);
+        }
+        std::cout << "Thread count: " << threadCount << std::endl;
+        break;
+    case 'b': // switch to the next broadphase, the new one starts from scratch next step
+        broadphaseType = static_cast<BroadphaseType>((static_cast<unsigned int>(broadphaseType) + 1) %
+            (static_cast<unsigned int>(BroadphaseType::AabbTree) + 1));
+        delete frameGraph;
+        frameGraph = nullptr;
+        delete broadphase;
+        broadphase = createBroadphase();
+        std::cout << "Broadphase: " << broadphase->Name() << std::endl;
+        break;
+    }
+}
+
+// called when the keyboard is used
+void keyboard(unsigned char key, int x, int y) {
+    static int* intPtr = nullptr;
+
+    switch (key)
+    {
     case 'q': // quits glut main loop (freeglut)
         glutLeaveMainLoop();
         break;
@@ -298,39 +713,12 @@ void keyboard(unsigned char key, int x, int y) {
             std::cout << "Press t first to allocate memory to be corrupted!" << std::endl;
         }
         break;
-    case 'r':
-    {
-        std::vector<ColliderObject*>& boxes = boxColliders->vector;
-        delete boxes.back();
-        boxes.pop_back();
-        std::cout << "Removed Box" << std::endl;
-    }
-    if (boxCount != 0) --boxCount;
+    case 'i': // toggle interpolating between the last two physics states when drawing
+        interpolateRendering = !interpolateRendering;
+        std::cout << "Interpolated rendering " << (interpolateRendering ? "on" : "off") << std::endl;
         break;
-    case 'a':
-    {
-        ColliderObject* box = ColliderObject::createCollider<Box>();
-        boxColliders->vector.emplace_back(box);
-        std::cout << "Added Box" << std::endl;
-    }
-    ++boxCount;
-        break;
-    case 'R':
-    {
-        std::vector<ColliderObject*>& spheres = sphereColliders->vector;
-        delete spheres.back();
-        spheres.pop_back();
-        std::cout << "Removed Sphere" << std::endl;
-    }
-    if (sphereCount != 0) --sphereCount;
-        break;
-    case 'A':
-    {
-        ColliderObject* sphere = ColliderObject::createCollider<Sphere>();
-        sphereColliders->vector.emplace_back(sphere);
-        std::cout << "Added Sphere" << std::endl;
-    }
-    ++sphereCount;
+    default:
+        postCommand([key]() { simulationKey(key); });
         break;
     }
 }
@@ -362,23 +750,18 @@ void initOpenGl()
 
 void initScene(int boxCount, int sphereCount)
 {
-    sphereColliders = new ColliderObjs(0U);
-    boxColliders = new ColliderObjs(sphereColliders, 0U);
-    boxColliders->vector.resize(boxCount);
-    sphereColliders->vector.resize(sphereCount);
+    colliders = new ColliderStore(boxCount + sphereCount);
+    renderSnapshots = new TripleBuffer<RenderSnapshot>();
+    threadPool = new ThreadPool(threadCount);
 
-    octree = new Octree(
-        Vec3((maxX - minX) / 2.0f, (maxY - minY) / 2.0f, (maxZ - minZ) / 2.0f),
-        Vec3(maxX - minX, maxZ - minZ, maxZ - minZ),
-        octreeDepth
-    );
+    broadphase = createBroadphase();
 
     for (int i = 0; i < boxCount; ++i) {
-        (*boxColliders)[i] = ColliderObject::createCollider<Box>();
+        ColliderObject::createCollider(*colliders, ColliderType::Box);
     }
 
     for (int i = 0; i < sphereCount; ++i) {
-        (*sphereColliders)[i] = ColliderObject::createCollider<Sphere>();
+        ColliderObject::createCollider(*colliders, ColliderType::Sphere);
     }
 }
 
@@ -388,11 +771,36 @@ int getConstants()
     std::cin >> sphereCount;
     std::cout << "Number of cubes: ";
     std::cin >> boxCount;
-    std::cout << "Octree depth: ";
-    std::cin >> octreeDepth;
-    if (octreeDepth >= maxOctantDepth)
+    std::cout << "Broadphase (0 octree, 1 uniform grid, 2 sweep and prune, 3 aabb tree): ";
+    unsigned int broadphase = 0;
+    std::cin >> broadphase;
+    broadphaseType = static_cast<BroadphaseType>(std::min(broadphase, static_cast<unsigned int>(BroadphaseType::AabbTree)));
+    if (broadphaseType == BroadphaseType::Octree)
     {
-        return 1;
+        std::cout << "Octree depth: ";
+        std::cin >> octreeDepth;
+        std::cout << "Octree layout (0 full, 1 adaptive, 2 sparse hashed up to depth " << maxSparseOctantDepth
+            << ", 3 linear up to depth " << maxLinearOctantDepth << "): ";
+        unsigned int layout = 0;
+        std::cin >> layout;
+        octreeLayout = static_cast<OctreeLayout>(std::min(layout, static_cast<unsigned int>(OctreeLayout::Linear)));
+        const unsigned int depthLimit =
+            octreeLayout == OctreeLayout::Sparse ? maxSparseOctantDepth :
+            octreeLayout == OctreeLayout::Linear ? maxLinearOctantDepth :
+            maxOctantDepth - 1;
+        if (octreeDepth > depthLimit)
+        {
+            return 1;
+        }
+        if (octreeLayout != OctreeLayout::Linear)
+        {
+            std::cout << "Octree looseness (1 for a tight octree, 2 is typical for a loose one): ";
+            std::cin >> octreeLooseness;
+            if (octreeLooseness < 1.0f)
+            {
+                octreeLooseness = 1.0f;
+            }
+        }
     }
     std::cout << "Thread count: ";
     std::cin >> threadCount;
@@ -400,6 +808,20 @@ int getConstants()
     {
         return 2;
     }
+    std::cout << "Deterministic seed (0 for a random run): ";
+    std::cin >> randomSeed;
+    deterministic = randomSeed != 0;
+    if (!deterministic)
+    {
+        randomSeed = static_cast<unsigned>(time(0));
+    }
+    std::cout << "Substeps per fixed step (0 for a variable timestep): ";
+    std::cin >> substeps;
+    if (deterministic && substeps == 0)
+    {
+        // deterministic runs can't depend on how long frames take
+        substeps = 1;
+    }
     MemoryPoolManager::Init();
     return 0;
 }
@@ -417,7 +839,7 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    srand(static_cast<unsigned>(time(0))); // Seed random number generator
+    ColliderObject::seedRandom(randomSeed); // Seed random number generator
     initGlut(argc, argv);
     initOpenGl();
     
@@ -429,6 +851,12 @@ int main(int argc, char** argv) {
         TimeLogger::LogInit(timer.Elapsed());
     }
 
+    // give the first frame something to draw, then hand the store over to the physics thread
+    recordPreviousPositions();
+    publishSnapshot();
+    physicsRunning = true;
+    physicsThread = std::thread(physicsLoop);
+
     // it will stick here until the program ends. 
     glutMainLoop();
 